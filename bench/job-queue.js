@@ -0,0 +1,34 @@
+// Measures job queue throughput (jobs/sec) for promise reaction jobs
+//
+// usage: zoe bench/job-queue.js [iterations]
+
+function chain(count) {
+  let p = Promise.resolve(0);
+  for (let i = 0; i < count; ++i) {
+    p = p.then(x => x + 1);
+  }
+  return p;
+}
+
+function fanOut(count) {
+  let promises = [];
+  for (let i = 0; i < count; ++i) {
+    promises.push(Promise.resolve(i).then(x => x));
+  }
+  return Promise.all(promises);
+}
+
+async function measure(name, count, fn) {
+  let start = Date.now();
+  await fn(count);
+  let ms = Math.max(Date.now() - start, 1);
+  print(`${ name }: ${ count } jobs in ${ ms }ms (${ Math.round(count / ms * 1000) } jobs/sec)`);
+}
+
+export async function main(zoe) {
+  let count = Number(zoe.args()[2]) || 1000000;
+  // Warm up
+  await chain(1000);
+  await measure('chain', count, chain);
+  await measure('fan-out', count, fanOut);
+}
@@ -0,0 +1,25 @@
+// Measures the round-trip cost of calling a native function
+//
+// usage: zoe bench/native-call.js --zoe-test-sys-api [iterations]
+
+function measure(name, count, fn) {
+  let start = Date.now();
+  for (let i = 0; i < count; ++i) {
+    fn();
+  }
+  let ms = Math.max(Date.now() - start, 1);
+  print(`${ name }: ${ count } calls in ${ ms }ms (${ Math.round(count / ms * 1e6) / 1000 }ns/call)`);
+}
+
+export function main(zoe) {
+  if (!zoe.sys) {
+    throw new Error('zoe.sys is not defined (use --zoe-test-sys-api flag to enable)');
+  }
+
+  let sys = zoe.sys;
+  let count = Number(zoe.args()[2]) || 1000000;
+
+  // Writing no arguments exercises only the call path
+  measure('stdout()', count, () => sys.stdout());
+  measure('stats()', count / 100, () => sys.stats());
+}
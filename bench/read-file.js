@@ -0,0 +1,110 @@
+// Measures file reads over a range of file sizes, and the latency of
+// small asynchronous file operations
+//
+// usage: zoe bench/read-file.js --zoe-test-sys-api directory [iterations]
+//
+// The directory must contain input files named by size. They can be
+// created with:
+//
+//   for size in 1K 64K 1M 16M 64M 256M 1G; do
+//     head -c $size /dev/zero | tr '\0' 'x' > directory/$size.txt
+//   done
+
+const sizes = ['1K', '64K', '1M', '16M', '64M', '256M', '1G'];
+
+function report(name, count, ms, bytes) {
+  ms = Math.max(ms, 1);
+  let mbPerSec = Math.round(bytes / (1024 * 1024) / ms * 1000);
+  let usPerOp = Math.round(ms * 1000 / count);
+  print(`${ name }: ${ count } ops in ${ ms }ms (${ usPerOp }us/op, ${ mbPerSec } MB/sec)`);
+}
+
+function measure(name, count, fn) {
+  let start = Date.now();
+  let bytes = 0;
+  for (let i = 0; i < count; ++i) {
+    bytes += fn().length;
+  }
+  report(name, count, Date.now() - start, bytes);
+}
+
+// Operations are run one after another, so that the time per operation
+// is its latency rather than the throughput of the thread pool
+async function measureAsync(name, count, fn) {
+  let start = Date.now();
+  let bytes = 0;
+  for (let i = 0; i < count; ++i) {
+    bytes += await fn();
+  }
+  report(name, count, Date.now() - start, bytes);
+}
+
+function call(fn, ...args) {
+  return new Promise((resolve, reject) => {
+    fn(...args, (err, result) => {
+      if (err) reject(err);
+      else resolve(result);
+    });
+  });
+}
+
+export async function main(zoe) {
+  if (!zoe.sys) {
+    throw new Error('zoe.sys is not defined (use --zoe-test-sys-api flag to enable)');
+  }
+
+  let sys = zoe.sys;
+  let args = zoe.args();
+  let directory = sys.resolveFilePath(args[2] + '/', sys.cwd());
+  let count = Number(args[3]) || 20;
+
+  print('readTextFileSync');
+  for (let size of sizes) {
+    let url = sys.resolveURL(`${ size }.txt`, directory);
+    // Small files are read more often, and the largest only once
+    let iterations = size.endsWith('K') ? count * 10 : size.endsWith('G') ? 1 : count;
+    try {
+      measure(size, iterations, () => sys.readTextFileSync(url));
+    } catch (err) {
+      print(`${ size }: ${ err.message }`);
+    }
+  }
+
+  print('readFile');
+  for (let size of sizes.filter(size => size.endsWith('K'))) {
+    let url = sys.resolveURL(`${ size }.txt`, directory);
+    try {
+      await measureAsync(size, count * 10, async () => {
+        return (await call(sys.readFile, url)).byteLength;
+      });
+    } catch (err) {
+      print(`${ size }: ${ err.message }`);
+    }
+  }
+
+  let outURL = sys.resolveURL(`zoe-bench-${ Date.now() }.txt`, sys.tempDirectory());
+  let data = new Uint8Array(1024);
+
+  print('writeFile');
+  await measureAsync('1K', count * 10, async () => {
+    await call(sys.writeFile, outURL, data, false);
+    return data.length;
+  });
+  await measureAsync('1K flushed', count, async () => {
+    await call(sys.writeFile, outURL, data, true);
+    return data.length;
+  });
+
+  print('statFile');
+  await measureAsync('existing', count * 10, async () => {
+    await call(sys.statFile, outURL);
+    return 0;
+  });
+
+  await call(sys.removeFile, outURL);
+
+  await measureAsync('missing', count * 10, async () => {
+    await call(sys.statFile, outURL);
+    return 0;
+  });
+}
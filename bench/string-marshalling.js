@@ -0,0 +1,29 @@
+// Measures the cost of passing short and long strings to native functions
+//
+// usage: zoe bench/string-marshalling.js --zoe-test-sys-api [iterations]
+
+function measure(name, count, fn) {
+  let start = Date.now();
+  for (let i = 0; i < count; ++i) {
+    fn();
+  }
+  let ms = Math.max(Date.now() - start, 1);
+  print(`${ name }: ${ count } calls in ${ ms }ms (${ Math.round(count / ms * 1000) } calls/sec)`);
+}
+
+export function main(zoe) {
+  if (!zoe.sys) {
+    throw new Error('zoe.sys is not defined (use --zoe-test-sys-api flag to enable)');
+  }
+
+  let sys = zoe.sys;
+  let count = Number(zoe.args()[2]) || 100000;
+  let base = 'file:///base/';
+  let shortPath = 'a/b.js';
+  let longPath = 'a/'.repeat(2000) + 'b.js';
+  let nonAscii = 'déjà/'.repeat(500) + 'b.js';
+
+  measure('short', count, () => sys.resolveURL(shortPath, base));
+  measure('long', count / 10, () => sys.resolveURL(longPath, base));
+  measure('long (non-ascii)', count / 10, () => sys.resolveURL(nonAscii, base));
+}
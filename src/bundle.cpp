@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "bundle.h"
+#include "url.h"
+
+using url::URLInfo;
+
+namespace bundle {
+
+  namespace {
+
+    std::string directory_url(const std::string& url) {
+      auto info = URLInfo::parse(url);
+      return URLInfo::stringify(URLInfo::parse("./", &info));
+    }
+
+    // Returns the URL relative to the base directory URL. URLs with a
+    // different origin are returned unchanged.
+    std::string relative_key(std::string_view url, std::string_view base) {
+      size_t scheme_end = base.find("://");
+      size_t path_start = scheme_end == std::string_view::npos
+        ? std::string_view::npos
+        : base.find('/', scheme_end + 3);
+
+      if (
+        path_start == std::string_view::npos ||
+        url.substr(0, path_start + 1) != base.substr(0, path_start + 1))
+      {
+        return std::string {url};
+      }
+
+      // Find the end of the last path segment that both URLs share
+      size_t common = path_start + 1;
+      for (size_t i = common; i < base.size() && i < url.size() && base[i] == url[i]; ++i) {
+        if (base[i] == '/') {
+          common = i + 1;
+        }
+      }
+
+      std::string key;
+      for (size_t i = common; i < base.size(); ++i) {
+        if (base[i] == '/') {
+          key.append("../");
+        }
+      }
+      key.append(url.substr(common));
+      return key;
+    }
+
+  }
+
+  void write(
+    const std::string& path,
+    const std::string& main_url,
+    const std::vector<Module>& modules)
+  {
+    struct Item {
+      std::string key;
+      std::string_view source;
+      bool main;
+    };
+
+    auto base_url = directory_url(main_url);
+
+    std::vector<Item> items;
+    items.reserve(modules.size());
+    for (auto& module : modules) {
+      items.push_back({
+        relative_key(module.url, base_url),
+        module.source,
+        module.url == main_url,
+      });
+    }
+
+    std::sort(items.begin(), items.end(), [](auto& a, auto& b) {
+      return a.key < b.key;
+    });
+
+    auto main_item = std::find_if(items.begin(), items.end(), [](auto& item) {
+      return item.main;
+    });
+    if (main_item == items.end()) {
+      throw os::Error {"Main module is not in the bundle (" + main_url + ")", "EINVAL"};
+    }
+
+    Header header {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.entry_count = static_cast<uint32_t>(items.size());
+
+    std::vector<Entry> entries(items.size());
+    uint64_t offset = sizeof(Header) + sizeof(Entry) * entries.size();
+    for (size_t i = 0; i < items.size(); ++i) {
+      auto& entry = entries[i];
+      entry.key_offset = offset;
+      entry.key_length = static_cast<uint32_t>(items[i].key.size());
+      offset += entry.key_length;
+      entry.source_offset = offset;
+      entry.source_length = static_cast<uint32_t>(items[i].source.size());
+      offset += entry.source_length;
+    }
+    header.main_index = static_cast<uint32_t>(main_item - items.begin());
+
+    std::ofstream out {path, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(
+      reinterpret_cast<const char*>(entries.data()),
+      sizeof(Entry) * entries.size());
+
+    for (auto& item : items) {
+      out.write(item.key.data(), item.key.size());
+      out.write(item.source.data(), item.source.size());
+    }
+
+    if (!out) {
+      throw os::Error {"Unable to write bundle (" + path + ")", "EIO"};
+    }
+  }
+
+  std::shared_ptr<const Bundle> Bundle::open(const std::string& path) {
+    auto bundle = std::make_shared<Bundle>();
+    bundle->_file = os::map_file(path);
+
+    auto invalid = [&]() {
+      return os::Error {"Invalid bundle file (" + path + ")", "EINVAL"};
+    };
+
+    const uint8_t* data = bundle->_file.data;
+    size_t size = bundle->_file.size;
+    if (size < sizeof(Header)) {
+      throw invalid();
+    }
+
+    auto* header = reinterpret_cast<const Header*>(data);
+    if (
+      std::memcmp(header->magic, magic, sizeof(magic)) != 0 ||
+      header->version != version ||
+      (size - sizeof(Header)) / sizeof(Entry) < header->entry_count ||
+      header->main_index >= header->entry_count)
+    {
+      throw invalid();
+    }
+
+    // Entries are validated up front so that lookups can skip bounds checks
+    bundle->_entries = reinterpret_cast<const Entry*>(data + sizeof(Header));
+    bundle->_entry_count = header->entry_count;
+    bundle->_main_index = header->main_index;
+    for (uint32_t i = 0; i < bundle->_entry_count; ++i) {
+      auto& entry = bundle->_entries[i];
+      if (
+        entry.key_offset > size ||
+        entry.key_length > size - entry.key_offset ||
+        entry.source_offset > size ||
+        entry.source_length > size - entry.source_offset)
+      {
+        throw invalid();
+      }
+    }
+
+    auto cwd_url = URLInfo::from_file_path(os::cwd() + "/");
+    auto url_info = URLInfo::from_file_path(path, &cwd_url);
+    bundle->_base_url = directory_url(URLInfo::stringify(url_info));
+
+    return bundle;
+  }
+
+  std::string_view Bundle::key(const Entry& entry) const {
+    return {
+      reinterpret_cast<const char*>(_file.data + entry.key_offset),
+      entry.key_length,
+    };
+  }
+
+  std::string_view Bundle::source(const Entry& entry) const {
+    return {
+      reinterpret_cast<const char*>(_file.data + entry.source_offset),
+      entry.source_length,
+    };
+  }
+
+  std::string Bundle::main_url() const {
+    auto base_info = URLInfo::parse(_base_url);
+    auto main_key = std::string {key(_entries[_main_index])};
+    return URLInfo::stringify(URLInfo::parse(main_key, &base_info));
+  }
+
+  bool Bundle::find(std::string_view url, std::string_view& result) const {
+    auto search_key = relative_key(url, _base_url);
+    auto end = _entries + _entry_count;
+    auto entry = std::lower_bound(_entries, end, search_key, [&](auto& entry, auto& k) {
+      return key(entry) < k;
+    });
+    if (entry == end || key(*entry) != search_key) {
+      return false;
+    }
+    result = source(*entry);
+    return true;
+  }
+
+  bool has_bundle_extension(std::string_view path) {
+    return
+      path.size() > extension.size() &&
+      path.substr(path.size() - extension.size()) == extension;
+  }
+
+}
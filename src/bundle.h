@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "os.h"
+
+namespace bundle {
+
+  // Bundle file layout. Integers are stored in native byte order.
+  //
+  //   Header
+  //   Entry[entry_count], sorted by key
+  //   Key and source bytes
+  //
+  // Keys are module URLs relative to the directory containing the bundle,
+  // so that a bundle can be deployed to any location.
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t main_index;
+    uint32_t flags;
+  };
+
+  struct Entry {
+    uint64_t key_offset;
+    uint64_t source_offset;
+    uint32_t key_length;
+    uint32_t source_length;
+  };
+
+  inline constexpr char magic[8] = {'Z', 'O', 'E', 'B', 'N', 'D', 'L', '\0'};
+  inline constexpr uint32_t version = 1;
+
+  // The file extension used to recognize bundles on the command line
+  inline constexpr std::string_view extension = ".zbundle";
+
+  // A module to be written to a bundle
+  struct Module {
+    std::string url;
+    std::string_view source;
+  };
+
+  // Writes a bundle file. Module URLs are stored relative to the directory
+  // of the main module. Throws os::Error if the main module is not one of
+  // the modules, or if the file cannot be written.
+  void write(
+    const std::string& path,
+    const std::string& main_url,
+    const std::vector<Module>& modules);
+
+  // A memory-mapped bundle file
+  struct Bundle {
+    os::MappedFile _file;
+    std::string _base_url;
+    const Entry* _entries = nullptr;
+    uint32_t _entry_count = 0;
+    uint32_t _main_index = 0;
+
+    // Maps a bundle file. Throws os::Error if the file cannot be read or
+    // is not a valid bundle.
+    static std::shared_ptr<const Bundle> open(const std::string& path);
+
+    // Returns the URL of the main module
+    std::string main_url() const;
+
+    // Returns true and sets `source` if the bundle contains a module with
+    // the specified URL
+    bool find(std::string_view url, std::string_view& source) const;
+
+    std::string_view key(const Entry& entry) const;
+    std::string_view source(const Entry& entry) const;
+  };
+
+  // Returns true if the path has the bundle file extension
+  bool has_bundle_extension(std::string_view path);
+
+}
@@ -3,36 +3,130 @@
 namespace event_loop {
 
   using js::Var;
+  using js::Job;
+  using js::JobKind;
+  using js::JobLane;
+
+  namespace {
+
+    DispatchMode dispatch_mode = DispatchMode::coalesced;
+    uint64_t dispatch_count = 0;
+
+    uv_check_t check_handle;
+    uv_idle_t idle_handle;
+
+    void schedule_turn_end();
+
+    template<typename API>
+    void end_turn(API& api, bool drained) {
+      if (!drained) {
+        // The flush budget was used up. Let the loop process I/O and
+        // resume the remaining jobs on the next iteration.
+        schedule_turn_end();
+        return;
+      }
+      // Unhandled rejections are reported at the end of the turn, so
+      // that handlers attached by later jobs are taken into account
+      api.report_unhandled_rejections();
+    }
+
+    void check_callback(uv_check_t*) {
+      uv_idle_stop(&idle_handle);
+      js::enter_current_realm([](auto& api) {
+        bool drained = true;
+        if (api.has_pending_jobs()) {
+          drained = api.flush_job_queue();
+        }
+        end_turn(api, drained);
+      });
+    }
+
+    void idle_callback(uv_idle_t*) {
+      // An active idle handle prevents the loop from blocking for I/O
+      // while jobs or unhandled rejections are pending. They are
+      // processed from the check handle.
+    }
+
+    void schedule_turn_end() {
+      if (!uv_is_active(reinterpret_cast<uv_handle_t*>(&idle_handle))) {
+        uv_idle_start(&idle_handle, idle_callback);
+      }
+    }
+
+    template<typename API>
+    void dispatch(API& api, Job&& job) {
+      api.enqueue_job(std::move(job), JobLane::host);
+      if (dispatch_mode == DispatchMode::coalesced) {
+        // Host tasks are run from the check handle
+        schedule_turn_end();
+        return;
+      }
+      bool drained = api.flush_job_queue();
+      if (!drained || api.has_unhandled_rejections()) {
+        schedule_turn_end();
+      }
+    }
+
+  }
+
+  void set_dispatch_mode(DispatchMode mode) {
+    dispatch_mode = mode;
+  }
 
   void dispatch_event(Var callback, Var result) {
     // TODO: Handle thrown errors
+    dispatch_count += 1;
     js::enter_object_realm(callback, [&](auto& api) {
-      api.enqueue_job(callback, {
+      dispatch(api, Job {JobKind::call, callback, {
         api.undefined(),
         api.undefined(),
         result ? result : api.undefined(),
-      });
-      api.flush_job_queue();
+      }});
     });
   }
 
   void dispatch_error(Var callback, Var error) {
     // TODO: Handle thrown errors
+    dispatch_count += 1;
     js::enter_object_realm(callback, [&](auto& api) {
-      api.enqueue_job(callback, {
+      dispatch(api, Job {JobKind::call, callback, {
         api.undefined(),
         error,
-      });
-      api.flush_job_queue();
+      }});
     });
   }
 
   void run() {
+    auto* loop = uv_default_loop();
+
+    // The check handle should not keep the loop alive by itself
+    uv_check_init(loop, &check_handle);
+    uv_check_start(&check_handle, check_callback);
+    uv_unref(reinterpret_cast<uv_handle_t*>(&check_handle));
+    uv_idle_init(loop, &idle_handle);
+
+    // Idle time is only tracked when enabled before the loop starts
+    uv_loop_configure(loop, UV_METRICS_IDLE_TIME);
+
     js::enter_current_realm([](auto& api) {
-      api.flush_job_queue();
+      end_turn(api, api.flush_job_queue());
     });
 
-    uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+    uv_run(loop, UV_RUN_DEFAULT);
+  }
+
+  LoopStats stats() {
+    auto* loop = uv_default_loop();
+    LoopStats result;
+    result.idle_time_ns = uv_metrics_idle_time(loop);
+    result.dispatch_count = dispatch_count;
+    uv_walk(loop, [](uv_handle_t* handle, void* arg) {
+      if (uv_is_active(handle)) {
+        auto* counts = reinterpret_cast<std::map<std::string, unsigned>*>(arg);
+        (*counts)[uv_handle_type_name(handle->type)] += 1;
+      }
+    }, &result.active_handles);
+    return result;
   }
 
 }
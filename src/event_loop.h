@@ -1,12 +1,32 @@
 #pragma once
 
+#include <map>
+
 #include "common.h"
 #include "js_engine.h"
 
 namespace event_loop {
 
+  enum class DispatchMode {
+    // The job queue is flushed after every libuv completion
+    immediate,
+    // Completions are queued and the job queue is flushed once per
+    // loop iteration
+    coalesced,
+  };
+
+  struct LoopStats {
+    uint64_t idle_time_ns = 0;
+    uint64_t dispatch_count = 0;
+    std::map<std::string, unsigned> active_handles;
+  };
+
+  void set_dispatch_mode(DispatchMode mode);
   void dispatch_event(js::Var callback, js::Var result = nullptr);
   void dispatch_error(js::Var callback, js::Var error);
   void run();
 
+  // Returns loop metrics. Handles are counted when this is called.
+  LoopStats stats();
+
 }
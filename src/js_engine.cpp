@@ -1,4 +1,8 @@
 #include "js_engine.h"
+#include "os.h"
+#include "bundle.h"
+#include "module_trace.h"
+#include "module_prefetch.h"
 
 namespace {
   using namespace js;
@@ -19,10 +23,11 @@ namespace {
     void* state)
   {
     enter_current_realm([=](auto& api) {
-      JobKind job_type = handled
-        ? JobKind::remove_unhandled_rejection
-        : JobKind::add_unhandled_rejection;
-      api.enqueue_job(Job {job_type, promise, {reason}});
+      if (handled) {
+        api.untrack_rejection(promise);
+      } else {
+        api.track_rejection(promise, reason);
+      }
     });
   }
 
@@ -57,7 +62,7 @@ namespace {
         JobKind::evaluate_module,
         api.undefined(),
         {module, exception},
-      });
+      }, JobLane::module);
     });
     return JsNoError;
   }
@@ -72,6 +77,36 @@ namespace {
     return JsNoError;
   }
 
+  bool CHAKRA_CALLBACK load_serialized_source(
+    JsSourceContext script_id,
+    Var* value,
+    JsParseScriptAttributes* attributes)
+  {
+    *attributes = JsParseScriptAttributeNone;
+    *value = enter_current_realm([&](auto& api) {
+      return api.serialized_script_source(script_id);
+    });
+    return *value != nullptr;
+  }
+
+  struct FileModuleCallback {
+    static void on_success(std::string& content, void* data) {
+      enter_current_realm([&](auto& api) {
+        api.set_module_source(reinterpret_cast<Var>(data), std::move(content));
+      });
+    }
+
+    static void on_error(const os::Error& error, void* data) {
+      enter_current_realm([&](auto& api) {
+        auto module = reinterpret_cast<Var>(data);
+        Var url_string;
+        JsGetModuleHostInfo(module, JsModuleHostInfo_Url, &url_string);
+        auto message = "Unable to load module (" + api.utf8_string(url_string) + ")";
+        api.set_module_source(module, api.create_error(message), nullptr);
+      });
+    }
+  };
+
   struct SetModuleSourceFunc : public NativeFunc {
     inline static std::string name = "setModuleSource";
     static Var call(RealmAPI& api, CallArgs& args) {
@@ -146,13 +181,31 @@ namespace js {
     }
   }
 
-  Realm::Realm(JsContextRef context, std::shared_ptr<JobQueue>& job_queue) {
+  Realm::Realm(
+    JsContextRef context,
+    std::shared_ptr<JobQueue>& job_queue,
+    std::shared_ptr<PropertyIdTable>& property_ids)
+  {
     _context = context;
     _info.job_queue = job_queue;
+    _info.property_ids = property_ids;
 
     JsSetContextData(_context, this);
 
     this->enter([&](auto& api) {
+      JsGetUndefinedValue(&_info.undefined_value);
+      JsGetNullValue(&_info.null_value);
+      JsGetTrueValue(&_info.true_value);
+      JsGetFalseValue(&_info.false_value);
+      JsGetGlobalObject(&_info.global_object);
+
+      // Cached before any script runs, so that later changes to
+      // Array.prototype do not affect native array construction
+      auto array_prototype = api.get_property(
+        api.global_property("Array"),
+        "prototype");
+      _info.array_push = VarRef {api.get_property(array_prototype, "push")};
+
       // Initialize promise callbacks
       JsSetPromiseContinuationCallback(enqueue_promise_callback, nullptr);
       JsSetHostPromiseRejectionTracker(rejection_tracker_callback, nullptr);
@@ -185,9 +238,50 @@ namespace js {
     });
   }
 
+  Var RealmAPI::run_serialized(
+    const uint8_t* bytecode,
+    size_t length,
+    std::string_view source,
+    const std::string& url)
+  {
+    auto id = register_script(url);
+    _realm_info.serialized_sources[id] = source;
+
+    // The engine reads the bytecode in place for the lifetime of the script
+    Var buffer;
+    _checked(JsCreateExternalArrayBuffer(
+      const_cast<uint8_t*>(bytecode),
+      static_cast<unsigned>(length),
+      nullptr,
+      nullptr,
+      &buffer));
+
+    Var result;
+    JsErrorCode error = JsRunSerialized(
+      buffer,
+      load_serialized_source,
+      id,
+      create_string(url),
+      &result);
+
+    if (error == JsErrorBadSerializedScript) {
+      return nullptr;
+    }
+    _checked(error);
+    return result;
+  }
+
+  Var RealmAPI::serialized_script_source(JsSourceContext script_id) {
+    auto source = _realm_info.serialized_sources.find(script_id);
+    if (!source) {
+      return nullptr;
+    }
+    return create_string(source->data(), source->length());
+  }
+
   JsModuleRecord RealmAPI::resolve_module_specifier(
     Var specifier,
-    const URLInfo* base_url,
+    UrlId base,
     JsModuleRecord importer)
   {
     // TODO: Handle failure to parse as URL. We can assume that base_url
@@ -195,22 +289,75 @@ namespace js {
     // would fail? Do we need to create a module record and set the
     // module's exception?
 
+    auto& resolutions = _realm_info.resolutions;
+    auto specifier_view = utf8_view(specifier);
+    if (auto* cached = resolutions.find(base, specifier_view)) {
+      return cached->record.var();
+    }
+
     // Resolve the specifier
-    auto url_info = URLInfo::parse(utf8_string(specifier), base_url);
+    std::string specifier_text {specifier_view};
+    const URLInfo* base_url = base == UrlTable::none
+      ? nullptr
+      : &_realm_info.urls.info(base);
+    auto url_info = URLInfo::parse(specifier_text, base_url);
     auto url = URLInfo::stringify(url_info);
-    Var url_string = create_string(url);
+
+    auto* tracer = _realm_info.module_tracer.get();
 
     // Return the module if it already exists
-    if (Var module = find_module_record(url)) {
-      return module;
+    if (UrlId existing = _realm_info.urls.find(url); existing != UrlTable::none) {
+      if (auto p = _realm_info.module_map.find(existing)) {
+        if (tracer && importer) {
+          tracer->on_import(base, existing);
+        }
+        resolutions.add(base, std::move(specifier_text), *p);
+        return (*p)->record.var();
+      }
+    }
+
+    Var url_string = create_string(url);
+    UrlId url_id = _realm_info.urls.intern(std::move(url), std::move(url_info));
+
+    if (tracer) {
+      tracer->on_resolve(url_id, _realm_info.urls.url(url_id));
+      if (importer) {
+        tracer->on_import(base, url_id);
+      }
     }
 
     // Create a new module record
     JsModuleRecord module;
     JsInitializeModuleRecord(importer, url_string, &module);
     JsSetModuleHostInfo(module, JsModuleHostInfo_Url, url_string);
-    _realm_info.module_map[url] = VarRef {module};
-    _realm_info.module_info[module].url = std::move(url_info);
+    auto& info = _realm_info.modules.emplace_back();
+    info.record = VarRef {module};
+    info.url = url_id;
+    _realm_info.module_map[url_id] = &info;
+    _realm_info.module_info[module] = &info;
+    resolutions.add(base, std::move(specifier_text), &info);
+
+    // Bundled sources are parsed in place from the mapped bundle file
+    auto& bundle = _realm_info.bundle;
+    if (bundle && bundle->find(_realm_info.urls.url(url_id), info.bundled_source)) {
+      if (tracer) {
+        tracer->on_load(url_id);
+      }
+      info.state = ModuleState::parsing;
+      enqueue_job(Job {
+        JobKind::parse_module,
+        undefined(),
+        {module},
+      }, JobLane::module);
+      return module;
+    }
+
+    // File modules are read natively and their bytes are handed directly
+    // to the parser. Other schemes are loaded by the module load callback.
+    if (_realm_info.urls.info(url_id).scheme == "file") {
+      load_file_module(module, url_id);
+      return module;
+    }
 
     // Create a finisher callback
     Var fn = create_function<SetModuleSourceFunc>(module);
@@ -220,7 +367,7 @@ namespace js {
       JobKind::call,
       get_module_load_callback(),
       {undefined(), url_string, fn},
-    });
+    }, JobLane::module);
 
     return module;
   }
@@ -229,7 +376,7 @@ namespace js {
     ModuleInfo* info = find_module_info(module);
     assert(info);
     if (info->state != ModuleState::loading) {
-      // TODO: Throw (module not loading)
+      throw_exception(create_error("Module source has already been set"));
     }
 
     if (is_null_or_undefined(error)) {
@@ -239,12 +386,56 @@ namespace js {
       JsSetModuleHostInfo(module, JsModuleHostInfo_Exception, error);
     }
 
+    if (auto* tracer = _realm_info.module_tracer.get()) {
+      tracer->on_load(info->url);
+    }
+
     info->state = ModuleState::parsing;
     enqueue_job(Job {
       JobKind::parse_module,
       undefined(),
       {module},
-    });
+    }, JobLane::module);
+  }
+
+  void RealmAPI::set_module_source(Var module, std::string&& source) {
+    ModuleInfo* info = find_module_info(module);
+    assert(info);
+
+    // Native sources are only provided by the loader for modules that it
+    // started loading
+    assert(info->state == ModuleState::loading);
+    if (info->state != ModuleState::loading) {
+      return;
+    }
+
+    if (auto* prefetcher = _realm_info.module_prefetcher.get()) {
+      prefetcher->on_loaded(_realm_info.urls.url(info->url), source.size());
+    }
+
+    info->source_text = std::move(source);
+    if (auto* tracer = _realm_info.module_tracer.get()) {
+      tracer->on_load(info->url);
+    }
+
+    info->state = ModuleState::parsing;
+    enqueue_job(Job {
+      JobKind::parse_module,
+      undefined(),
+      {module},
+    }, JobLane::module);
+  }
+
+  void RealmAPI::load_file_module(Var module, UrlId url) {
+    auto* prefetcher = _realm_info.module_prefetcher.get();
+    if (prefetcher && prefetcher->claim(*this, _realm_info.urls.url(url), module)) {
+      return;
+    }
+
+    // The module record is kept alive by the module map until the read
+    // completes
+    auto path = URLInfo::to_file_path(_realm_info.urls.info(url));
+    os::read_text_file<FileModuleCallback>(path, module);
   }
 
   void RealmAPI::parse_module(Var module) {
@@ -254,19 +445,48 @@ namespace js {
       // TODO: throw error
     }
 
-    auto source = utf8_string(info->source.var());
-    info->source.release();
+    if (info->source) {
+      info->source_text = utf8_string(info->source.var());
+      info->source.release();
+    }
+
+    // Sources are kept after parsing when recording a module graph
+    std::string owned;
+    std::string_view source = info->bundled_source;
+    if (source.empty()) {
+      if (_realm_info.record_modules) {
+        source = info->source_text;
+      } else {
+        owned = std::move(info->source_text);
+        info->source_text.clear();
+        source = owned;
+      }
+    }
+
+    auto* tracer = _realm_info.module_tracer.get();
+    if (tracer) {
+      tracer->on_parse_start(info->url, source.size());
+    }
 
     Var err;
 
+    // TODO: [CC] Modules are re-parsed on every run. JSRT can only
+    // serialize bytecode or parser state for classic scripts (JsSerialize,
+    // JsSerializeParserState); there is no equivalent for module records,
+    // so an on-disk cache keyed by URL, content hash and engine version
+    // cannot be implemented without engine support.
     JsParseModuleSource(
       module,
       _realm_info.next_script_id++,
-      reinterpret_cast<uint8_t*>(source.data()),
+      reinterpret_cast<uint8_t*>(const_cast<char*>(source.data())),
       static_cast<unsigned>(source.length()),
       JsParseModuleSourceFlags_DataIsUTF8,
       &err);
 
+    if (tracer) {
+      tracer->on_parse_end(info->url);
+    }
+
     if (err) {
       info->state = ModuleState::error;
     } else {
@@ -285,8 +505,21 @@ namespace js {
       // TODO: throw error
     }
 
+    if (_realm_info.record_modules) {
+      return;
+    }
+
+    auto* tracer = _realm_info.module_tracer.get();
+    if (tracer) {
+      tracer->on_evaluate_start(info->url);
+    }
+
     JsModuleEvaluation(module, nullptr);
 
+    if (tracer) {
+      tracer->on_evaluate_end(info->url);
+    }
+
     bool errored = has_exception();
     if (errored) {
       info->state = ModuleState::error;
@@ -296,23 +529,162 @@ namespace js {
     info->state = ModuleState::complete;
   }
 
-  void JobQueue::flush() {
+  RejectionTracker& RejectionTracker::operator=(RejectionTracker&& other) {
+    if (this != &other) {
+      // References held by the entries being replaced are released
+      release_entries();
+      _table = std::move(other._table);
+      _size = other._size;
+      _next_sequence = other._next_sequence;
+      _added = other._added;
+      _removed = other._removed;
+      _reported = other._reported;
+      other._table.clear();
+      other._size = 0;
+    }
+    return *this;
+  }
+
+  void RejectionTracker::release_entries() {
+    for (auto& entry : _table) {
+      if (entry.promise) {
+        VarRef::decrement(entry.promise);
+        VarRef::decrement(entry.reason);
+      }
+    }
+    _table.clear();
+    _size = 0;
+  }
+
+  void RejectionTracker::add(Var promise, Var reason) {
+    if ((_size + 1) * 2 > _table.size()) {
+      grow();
+    }
+    size_t mask = _table.size() - 1;
+    size_t slot = slot_for(promise);
+    while (_table[slot].promise) {
+      if (_table[slot].promise == promise) {
+        return;
+      }
+      slot = (slot + 1) & mask;
+    }
+    VarRef::increment(promise);
+    VarRef::increment(reason);
+    _table[slot] = {promise, reason, _next_sequence++};
+    _size += 1;
+    _added += 1;
+  }
+
+  void RejectionTracker::remove(Var promise) {
+    if (_size == 0) {
+      return;
+    }
+    size_t mask = _table.size() - 1;
+    for (size_t slot = slot_for(promise); _table[slot].promise; slot = (slot + 1) & mask) {
+      if (_table[slot].promise == promise) {
+        VarRef::decrement(_table[slot].promise);
+        VarRef::decrement(_table[slot].reason);
+        erase_slot(slot);
+        _removed += 1;
+        return;
+      }
+    }
+  }
+
+  RejectionTracker::Entry RejectionTracker::take_oldest() {
+    assert(_size > 0);
+    size_t oldest = _table.size();
+    for (size_t slot = 0; slot < _table.size(); ++slot) {
+      if (
+        _table[slot].promise &&
+        (oldest == _table.size() || _table[slot].sequence < _table[oldest].sequence))
+      {
+        oldest = slot;
+      }
+    }
+    Entry entry = _table[oldest];
+    erase_slot(oldest);
+    _reported += 1;
+    return entry;
+  }
+
+  void RejectionTracker::grow() {
+    std::vector<Entry> table(_table.empty() ? initial_capacity : _table.size() * 2);
+    std::swap(table, _table);
+    size_t mask = _table.size() - 1;
+    for (auto& entry : table) {
+      if (entry.promise) {
+        size_t slot = slot_for(entry.promise);
+        while (_table[slot].promise) {
+          slot = (slot + 1) & mask;
+        }
+        _table[slot] = entry;
+      }
+    }
+  }
+
+  void RejectionTracker::erase_slot(size_t slot) {
+    // Backward-shift deletion keeps probe sequences intact without
+    // leaving tombstones behind
+    size_t mask = _table.size() - 1;
+    size_t next = (slot + 1) & mask;
+    while (_table[next].promise) {
+      size_t home = slot_for(_table[next].promise);
+      if (((next - home) & mask) >= ((next - slot) & mask)) {
+        _table[slot] = _table[next];
+        slot = next;
+      }
+      next = (next + 1) & mask;
+    }
+    _table[slot] = {};
+    _size -= 1;
+  }
+
+  void RealmAPI::report_unhandled_rejections() {
+    if (_realm_info.rejections.empty()) {
+      return;
+    }
+    auto entry = _realm_info.rejections.take_oldest();
+    set_exception(entry.reason);
+    VarRef::decrement(entry.promise);
+    VarRef::decrement(entry.reason);
+    throw ScriptError {};
+  }
+
+  bool JobQueue::flush() {
     // TODO: Make this non-reentrant?
-    std::list<Var> rejections;
-    std::map<Var, Var> rejection_reasons;
+    uint64_t start_time = uv_hrtime();
+    auto record_time = on_scope_exit([&]() {
+      uint64_t elapsed = uv_hrtime() - start_time;
+      _stats.flush_count += 1;
+      _stats.flush_time_ns += elapsed;
+      if (elapsed > _stats.max_flush_time_ns) {
+        _stats.max_flush_time_ns = elapsed;
+      }
+    });
+
+    size_t job_count = 0;
+
+    while (true) {
+      if (this->empty()) {
+        return true;
+      }
 
-    while (!this->empty()) {
-      Job job = std::move(this->dequeue());
+      if (job_count > 0 && budget_exceeded(job_count, start_time)) {
+        // Remaining jobs are run by a later flush
+        _stats.yield_count += 1;
+        return false;
+      }
+
+      job_count += 1;
+      Job job = this->dequeue();
       auto func = job.func();
       assert(func);
+      _stats.job_counts[static_cast<size_t>(job.kind())] += 1;
       enter_object_realm(func, [&](auto& api) {
         switch (job.kind()) {
           case JobKind::call: {
-            if (job.args().empty()) {
-              api.call_function(func, {api.undefined()});
-            } else {
-              api.call_function(func, job.args());
-            }
+            api.call_function(func, job.args(), job.arg_count());
             break;
           }
 
@@ -328,34 +700,9 @@ namespace js {
             api.evaluate_module(module, error);
             break;
           }
-
-          case JobKind::add_unhandled_rejection: {
-            rejections.push_back(func);
-            rejection_reasons[func] = job.args()[0];
-            break;
-          }
-
-          case JobKind::remove_unhandled_rejection: {
-            rejection_reasons.erase(func);
-            break;
-          }
         }
       });
     }
-
-    if (!rejection_reasons.empty()) {
-      for (auto promise : rejections) {
-        if (
-          auto it = rejection_reasons.find(promise);
-          it != rejection_reasons.end())
-        {
-          auto reason = it->second;
-          enter_object_realm(promise, [=](auto& api) {
-            api.throw_exception(reason);
-          });
-        }
-      }
-    }
   }
 
 }
@@ -1,15 +1,28 @@
 #pragma once
 
+#include <deque>
 #include <map>
-#include <list>
+#include <unordered_map>
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <string_view>
+#include <tuple>
+#include <limits>
+#include <type_traits>
 
 #include "common.h"
+#include "text.h"
 #include "url.h"
 
 using url::URLInfo;
 
+namespace bundle {
+  struct Bundle;
+}
+
 namespace js {
 
   using Var = JsValueRef;
@@ -81,7 +94,7 @@ namespace js {
 
   struct ScriptError {};
 
-  enum class ModuleState {
+  enum class ModuleState : uint8_t {
     loading,
     parsing,
     initializing,
@@ -89,81 +102,620 @@ namespace js {
     error,
   };
 
+  // Index of a canonical URL in a realm's URL table
+  using UrlId = uint32_t;
+
   struct ModuleInfo {
-    ModuleState state = ModuleState::loading;
-    URLInfo url;
+    VarRef record;
+    // Source provided by a JS module load callback
     VarRef source;
+    // UTF-8 source loaded natively
+    std::string source_text;
+    // UTF-8 source owned by a module bundle
+    std::string_view bundled_source;
+    UrlId url = 0;
+    ModuleState state = ModuleState::loading;
   };
 
   enum class JobKind {
     call,
     parse_module,
     evaluate_module,
-    add_unhandled_rejection,
-    remove_unhandled_rejection,
   };
 
+  constexpr size_t job_kind_count =
+    static_cast<size_t>(JobKind::evaluate_module) + 1;
+
   struct Job {
-    JobKind _kind;
+    // Jobs with more arguments than this spill to the heap
+    static constexpr unsigned inline_arg_count = 4;
+
+    JobKind _kind = JobKind::call;
+    unsigned _arg_count = 0;
     VarRef _func;
-    std::vector<Var> _args;
+    union {
+      Var _inline_args[inline_arg_count];
+      Var* _heap_args;
+    };
+
+    Job() {}
 
     Job(JobKind kind, Var func) : _kind {kind}, _func {func} {}
 
-    Job(JobKind kind, Var func, std::vector<Var>&& args) :
+    Job(JobKind kind, Var func, std::initializer_list<Var> args) :
       _kind {kind},
-      _func {func},
-      _args {args} // TODO: Copy/move??
+      _arg_count {static_cast<unsigned>(args.size())},
+      _func {func}
     {
+      Var* dest = _arg_count > inline_arg_count
+        ? (_heap_args = new Var[_arg_count])
+        : _inline_args;
       for (Var arg : args) {
         JsAddRef(arg, nullptr);
+        *dest++ = arg;
       }
     }
 
     Job(const Job& other) = delete;
     Job& operator=(const Job& other) = delete;
 
-    Job(Job&& other) = default;
-    Job& operator=(Job&& other) = default;
+    Job(Job&& other) :
+      _kind {other._kind},
+      _arg_count {other._arg_count},
+      _func {std::move(other._func)}
+    {
+      steal_args(other);
+    }
 
-    ~Job() {
-      for (Var arg : _args) {
-        JsRelease(arg, nullptr);
+    Job& operator=(Job&& other) {
+      if (this != &other) {
+        release_args();
+        _kind = other._kind;
+        _arg_count = other._arg_count;
+        _func = std::move(other._func);
+        steal_args(other);
       }
+      return *this;
+    }
+
+    ~Job() {
+      release_args();
     }
 
     const JobKind kind() const { return _kind; }
     const Var func() const { return _func.var(); }
-    const std::vector<Var>& args() const { return _args; }
+    unsigned arg_count() const { return _arg_count; }
+
+    const Var* args() const {
+      return _arg_count > inline_arg_count ? _heap_args : _inline_args;
+    }
+
+    void steal_args(Job& other) {
+      if (_arg_count > inline_arg_count) {
+        _heap_args = other._heap_args;
+      } else {
+        std::copy(other._inline_args, other._inline_args + _arg_count, _inline_args);
+      }
+      other._arg_count = 0;
+    }
+
+    void release_args() {
+      const Var* args = this->args();
+      for (unsigned i = 0; i < _arg_count; ++i) {
+        JsRelease(args[i], nullptr);
+      }
+      if (_arg_count > inline_arg_count) {
+        delete[] _heap_args;
+      }
+      _arg_count = 0;
+    }
+  };
+
+  struct JobQueueStats {
+    uint64_t job_counts[job_kind_count] = {};
+    uint64_t flush_count = 0;
+    uint64_t flush_time_ns = 0;
+    uint64_t max_flush_time_ns = 0;
+    uint64_t yield_count = 0;
+    size_t high_water_mark = 0;
+
+    uint64_t job_count(JobKind kind) const {
+      return job_counts[static_cast<size_t>(kind)];
+    }
+  };
+
+  // Limits the amount of work done by a single flush. A value of zero
+  // means no limit.
+  struct FlushBudget {
+    size_t max_jobs = 0;
+    uint64_t max_time_ns = 0;
+  };
+
+  // A growable ring buffer of jobs. Slots are reused once a job has been
+  // dequeued, so steady-state enqueue/dequeue performs no allocation.
+  struct JobRing {
+    static constexpr size_t initial_capacity = 64;
+
+    std::vector<Job> _buffer;
+    size_t _head = 0;
+    size_t _size = 0;
+
+    bool empty() const {
+      return _size == 0;
+    }
+
+    size_t size() const {
+      return _size;
+    }
+
+    void push(Job&& job) {
+      if (_size == _buffer.size()) {
+        grow();
+      }
+      _buffer[(_head + _size) & (_buffer.size() - 1)] = std::move(job);
+      _size += 1;
+    }
+
+    Job pop() {
+      assert(_size > 0);
+      Job job = std::move(_buffer[_head]);
+      _head = (_head + 1) & (_buffer.size() - 1);
+      _size -= 1;
+      return job;
+    }
+
+    void grow() {
+      // Capacity is always a power of two so that indexes can be masked
+      size_t capacity = _buffer.empty() ? initial_capacity : _buffer.size() * 2;
+      std::vector<Job> buffer(capacity);
+      for (size_t i = 0; i < _size; ++i) {
+        buffer[i] = std::move(_buffer[(_head + i) & (_buffer.size() - 1)]);
+      }
+      _buffer = std::move(buffer);
+      _head = 0;
+    }
+  };
+
+  // Lanes are listed in drain order
+  enum class JobLane {
+    // Promise reaction jobs
+    microtask,
+    // Callbacks for completed host operations
+    host,
+    // Module fetching, parsing and evaluation
+    module,
   };
 
+  constexpr size_t job_lane_count = static_cast<size_t>(JobLane::module) + 1;
+
+  // Jobs are always taken from the first non-empty lane. All pending
+  // microtasks therefore run before the next host task, and module
+  // loading only proceeds when no microtasks or host tasks are waiting.
   struct JobQueue {
-    std::list<Job> _queue;
+    JobRing _lanes[job_lane_count];
+    size_t _size = 0;
+    JobQueueStats _stats;
+    FlushBudget _budget;
+
+    const JobQueueStats& stats() const {
+      return _stats;
+    }
+
+    void set_budget(const FlushBudget& budget) {
+      _budget = budget;
+    }
 
     bool empty() const {
-      return _queue.empty();
+      return _size == 0;
+    }
+
+    size_t size() const {
+      return _size;
     }
 
-    void enqueue(Job&& job) {
-      _queue.push_back(std::move(job));
+    size_t size(JobLane lane) const {
+      return _lanes[static_cast<size_t>(lane)].size();
+    }
+
+    void enqueue(Job&& job, JobLane lane = JobLane::microtask) {
+      _lanes[static_cast<size_t>(lane)].push(std::move(job));
+      _size += 1;
+      if (_size > _stats.high_water_mark) {
+        _stats.high_water_mark = _size;
+      }
     }
 
     Job dequeue() {
-      Job job = std::move(_queue.front());
-      _queue.pop_front();
-      return job;
+      assert(_size > 0);
+      _size -= 1;
+      for (auto& lane : _lanes) {
+        if (!lane.empty()) {
+          return lane.pop();
+        }
+      }
+      assert(false);
+      return Job {};
+    }
+
+    bool budget_exceeded(size_t job_count, uint64_t start_time) const {
+      if (_budget.max_jobs != 0 && job_count >= _budget.max_jobs) {
+        return true;
+      }
+      if (_budget.max_time_ns != 0 && uv_hrtime() - start_time >= _budget.max_time_ns) {
+        return true;
+      }
+      return false;
+    }
+
+    // Runs jobs until the queue is empty. Returns false if the flush
+    // budget was used up before all jobs were run.
+    bool flush();
+  };
+
+  // An open-addressed hash set of rejected promises that do not yet have
+  // a handler. Entries persist across job queue flushes, so a handler that
+  // is attached later in the same turn simply removes its entry.
+  struct RejectionTracker {
+    struct Entry {
+      Var promise = nullptr;
+      Var reason = nullptr;
+      uint64_t sequence = 0;
+    };
+
+    static constexpr size_t initial_capacity = 16;
+
+    std::vector<Entry> _table;
+    size_t _size = 0;
+    uint64_t _next_sequence = 0;
+    uint64_t _added = 0;
+    uint64_t _removed = 0;
+    uint64_t _reported = 0;
+
+    RejectionTracker() = default;
+    RejectionTracker(const RejectionTracker& other) = delete;
+    RejectionTracker& operator=(const RejectionTracker& other) = delete;
+    RejectionTracker(RejectionTracker&& other) {
+      *this = std::move(other);
+    }
+
+    RejectionTracker& operator=(RejectionTracker&& other);
+
+    ~RejectionTracker() {
+      release_entries();
+    }
+
+    bool empty() const { return _size == 0; }
+    size_t size() const { return _size; }
+    uint64_t added() const { return _added; }
+    uint64_t removed() const { return _removed; }
+    uint64_t reported() const { return _reported; }
+
+    void add(Var promise, Var reason);
+    void remove(Var promise);
+
+    // Removes the oldest entry. The caller owns the references held
+    // by the returned entry.
+    Entry take_oldest();
+
+    size_t slot_for(Var promise) const {
+      // Fibonacci hashing of the pointer value
+      auto key = reinterpret_cast<uintptr_t>(promise) >> 4;
+      auto hash = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+      return static_cast<size_t>(hash >> 32) & (_table.size() - 1);
+    }
+
+    void grow();
+    void erase_slot(size_t slot);
+    void release_entries();
+  };
+
+  // An open-addressed hash map for pointer and integer keys. Entries are
+  // never removed; the registries that use it live as long as the realm.
+  template<typename Key, typename Value>
+  struct IdMap {
+    struct Slot {
+      Key key {};
+      bool used = false;
+      Value value {};
+    };
+
+    static constexpr size_t initial_capacity = 16;
+
+    std::vector<Slot> _table;
+    size_t _size = 0;
+
+    size_t size() const { return _size; }
+
+    Value* find(Key key) {
+      if (_size == 0) {
+        return nullptr;
+      }
+      size_t mask = _table.size() - 1;
+      for (size_t slot = slot_for(key); _table[slot].used; slot = (slot + 1) & mask) {
+        if (_table[slot].key == key) {
+          return &_table[slot].value;
+        }
+      }
+      return nullptr;
+    }
+
+    // Returns the value for the key, inserting a default value if the key
+    // is not present. Inserting may invalidate previously returned values.
+    Value& operator[](Key key) {
+      if (Value* value = find(key)) {
+        return *value;
+      }
+      if ((_size + 1) * 2 > _table.size()) {
+        grow();
+      }
+      size_t mask = _table.size() - 1;
+      size_t slot = slot_for(key);
+      while (_table[slot].used) {
+        slot = (slot + 1) & mask;
+      }
+      _table[slot].key = key;
+      _table[slot].used = true;
+      _size += 1;
+      return _table[slot].value;
+    }
+
+    size_t slot_for(Key key) const {
+      uint64_t bits;
+      if constexpr (std::is_pointer_v<Key>) {
+        bits = reinterpret_cast<uintptr_t>(key) >> 4;
+      } else {
+        bits = static_cast<uint64_t>(key);
+      }
+      auto hash = bits * 0x9E3779B97F4A7C15ull;
+      return static_cast<size_t>(hash >> 32) & (_table.size() - 1);
+    }
+
+    void grow() {
+      std::vector<Slot> table(_table.empty() ? initial_capacity : _table.size() * 2);
+      std::swap(table, _table);
+      size_t mask = _table.size() - 1;
+      for (auto& entry : table) {
+        if (entry.used) {
+          size_t slot = slot_for(entry.key);
+          while (_table[slot].used) {
+            slot = (slot + 1) & mask;
+          }
+          _table[slot] = std::move(entry);
+        }
+      }
+    }
+  };
+
+  // Canonical URLs used by a realm's module and script registries. Each
+  // URL is stored and parsed once, and is referred to by its index.
+  struct UrlTable {
+    struct Entry {
+      std::string url;
+      URLInfo info;
+      size_t hash;
+    };
+
+    static constexpr UrlId none = std::numeric_limits<UrlId>::max();
+    static constexpr size_t initial_capacity = 16;
+
+    // Entries are never moved, so that parsed URLs may be used as base URLs
+    // while other URLs are being interned
+    std::deque<Entry> _entries;
+    std::vector<UrlId> _index;
+
+    size_t size() const { return _entries.size(); }
+
+    const std::string& url(UrlId id) const { return _entries[id].url; }
+    const URLInfo& info(UrlId id) const { return _entries[id].info; }
+
+    UrlId find(std::string_view url) const {
+      return find(url, std::hash<std::string_view>{}(url));
+    }
+
+    UrlId intern(std::string&& url, URLInfo&& info) {
+      size_t hash = std::hash<std::string_view>{}(url);
+      if (UrlId id = find(url, hash); id != none) {
+        return id;
+      }
+      if ((_entries.size() + 1) * 2 > _index.size()) {
+        grow();
+      }
+      auto id = static_cast<UrlId>(_entries.size());
+      _entries.push_back({std::move(url), std::move(info), hash});
+      insert(id);
+      return id;
+    }
+
+    UrlId find(std::string_view url, size_t hash) const {
+      if (_index.empty()) {
+        return none;
+      }
+      size_t mask = _index.size() - 1;
+      for (size_t slot = hash & mask; _index[slot] != none; slot = (slot + 1) & mask) {
+        auto& entry = _entries[_index[slot]];
+        if (entry.hash == hash && entry.url == url) {
+          return _index[slot];
+        }
+      }
+      return none;
+    }
+
+    void insert(UrlId id) {
+      size_t mask = _index.size() - 1;
+      size_t slot = _entries[id].hash & mask;
+      while (_index[slot] != none) {
+        slot = (slot + 1) & mask;
+      }
+      _index[slot] = id;
+    }
+
+    void grow() {
+      _index.assign(_index.empty() ? initial_capacity : _index.size() * 2, none);
+      for (UrlId id = 0; id < _entries.size(); ++id) {
+        insert(id);
+      }
+    }
+  };
+
+  // Maps a (base URL, specifier) pair to the module that the specifier
+  // resolved to, so that repeated imports skip URL parsing
+  struct ResolutionCache {
+    struct Entry {
+      std::string specifier;
+      size_t hash = 0;
+      UrlId base = 0;
+      ModuleInfo* module = nullptr;
+    };
+
+    static constexpr size_t initial_capacity = 16;
+
+    std::vector<Entry> _table;
+    size_t _size = 0;
+
+    size_t size() const { return _size; }
+
+    static size_t hash_key(UrlId base, std::string_view specifier) {
+      auto hash = std::hash<std::string_view>{}(specifier);
+      return hash ^ (static_cast<size_t>(base) * 0x9E3779B97F4A7C15ull);
+    }
+
+    ModuleInfo* find(UrlId base, std::string_view specifier) const {
+      if (_size == 0) {
+        return nullptr;
+      }
+      size_t hash = hash_key(base, specifier);
+      size_t mask = _table.size() - 1;
+      for (size_t slot = hash & mask; _table[slot].module; slot = (slot + 1) & mask) {
+        auto& entry = _table[slot];
+        if (entry.hash == hash && entry.base == base && entry.specifier == specifier) {
+          return entry.module;
+        }
+      }
+      return nullptr;
+    }
+
+    void add(UrlId base, std::string&& specifier, ModuleInfo* module) {
+      if ((_size + 1) * 2 > _table.size()) {
+        grow();
+      }
+      size_t hash = hash_key(base, specifier);
+      insert({std::move(specifier), hash, base, module});
+      _size += 1;
+    }
+
+    void insert(Entry&& entry) {
+      size_t mask = _table.size() - 1;
+      size_t slot = entry.hash & mask;
+      while (_table[slot].module) {
+        slot = (slot + 1) & mask;
+      }
+      _table[slot] = std::move(entry);
     }
 
-    void flush();
+    void grow() {
+      std::vector<Entry> table(_table.empty() ? initial_capacity : _table.size() * 2);
+      std::swap(table, _table);
+      for (auto& entry : table) {
+        if (entry.module) {
+          insert(std::move(entry));
+        }
+      }
+    }
   };
 
+  // Well-known property names, for use with the compile-time keyed
+  // property accessors (e.g. `api.get_property<names::length>(object)`)
+  namespace names {
+    inline constexpr char chunk_size[] = "chunkSize";
+    inline constexpr char code[] = "code";
+    inline constexpr char column[] = "column";
+    inline constexpr char exception[] = "exception";
+    inline constexpr char length[] = "length";
+    inline constexpr char line[] = "line";
+    inline constexpr char offset[] = "offset";
+    inline constexpr char source[] = "source";
+    inline constexpr char stack[] = "stack";
+    inline constexpr char url[] = "url";
+    inline constexpr char writable[] = "writable";
+  }
+
+  // Interned property IDs for a runtime. IDs for names known at compile
+  // time are stored in slots, so that looking them up requires no string
+  // hashing or allocation.
+  struct PropertyIdTable {
+    // Owns the names that key `_ids`, so that lookups by string_view do
+    // not allocate
+    std::deque<std::string> _names;
+    std::unordered_map<std::string_view, JsPropertyIdRef> _ids;
+    std::vector<JsPropertyIdRef> _slots;
+
+    inline static unsigned _next_slot = 0;
+
+    template<const char* Name>
+    static unsigned slot() {
+      static const unsigned slot = _next_slot++;
+      return slot;
+    }
+
+    JsPropertyIdRef get(std::string_view name) {
+      if (auto p = _ids.find(name); p != _ids.end()) {
+        return p->second;
+      }
+      JsPropertyIdRef id;
+      if (auto code = JsCreatePropertyId(name.data(), name.length(), &id)) {
+        throw EngineError {code};
+      }
+      // Keep the property ID alive for the lifetime of the runtime
+      JsAddRef(id, nullptr);
+      _ids.emplace(_names.emplace_back(name), id);
+      return id;
+    }
+
+    template<const char* Name>
+    JsPropertyIdRef get() {
+      unsigned index = slot<Name>();
+      if (index < _slots.size() && _slots[index]) {
+        return _slots[index];
+      }
+      if (index >= _slots.size()) {
+        _slots.resize(index + 1, nullptr);
+      }
+      _slots[index] = get(std::string_view {Name});
+      return _slots[index];
+    }
+  };
+
+  struct ModuleTracer;
+  struct ModulePrefetcher;
+
   struct RealmInfo {
+    // Values that are fixed for the lifetime of the context
+    Var undefined_value = nullptr;
+    Var null_value = nullptr;
+    Var true_value = nullptr;
+    Var false_value = nullptr;
+    Var global_object = nullptr;
+    VarRef array_push;
+
     JsSourceContext next_script_id = 0;
     VarRef module_load_callback;
-    std::map<std::string, VarRef> module_map;
-    std::map<JsModuleRecord, ModuleInfo> module_info;
-    std::map<JsSourceContext, URLInfo> script_urls;
+    UrlTable urls;
+    std::deque<ModuleInfo> modules;
+    IdMap<UrlId, ModuleInfo*> module_map;
+    IdMap<JsModuleRecord, ModuleInfo*> module_info;
+    IdMap<JsSourceContext, UrlId> script_urls;
+    ResolutionCache resolutions;
+    IdMap<JsSourceContext, std::string_view> serialized_sources;
+    std::shared_ptr<const bundle::Bundle> bundle;
+    std::shared_ptr<ModuleTracer> module_tracer;
+    std::shared_ptr<ModulePrefetcher> module_prefetcher;
+    // When set, modules are parsed but not evaluated, and their sources
+    // are retained
+    bool record_modules = false;
     std::shared_ptr<JobQueue> job_queue;
+    std::shared_ptr<PropertyIdTable> property_ids;
+    RejectionTracker rejections;
+    std::string utf8_scratch;
   };
 
   // Forward
@@ -239,23 +791,48 @@ namespace js {
       return undefined();
     }
 
-    Var eval(Var source, const std::string& url = "") {
+    JsSourceContext register_script(const std::string& url) {
       auto id = _realm_info.next_script_id++;
-      _realm_info.script_urls[id] = URLInfo::parse(url);
+      auto url_info = URLInfo::parse(url);
+      auto canonical = URLInfo::stringify(url_info);
+      _realm_info.script_urls[id] = _realm_info.urls.intern(
+        std::move(canonical),
+        std::move(url_info));
+      return id;
+    }
+
+    Var eval(Var source, const std::string& url = "") {
+      auto id = register_script(url);
       Var result;
       _checked(JsRun(source, id, create_string(url), JsParseScriptAttributeNone, &result));
       return result;
     }
 
+    // Runs a script from bytecode produced by JsSerialize. The bytecode and
+    // the source must outlive the realm; the source is only read if the
+    // engine needs it (e.g. for Function.prototype.toString). Returns null
+    // if the bytecode was not produced by this engine build.
+    Var run_serialized(
+      const uint8_t* bytecode,
+      size_t length,
+      std::string_view source,
+      const std::string& url = "");
+
+    Var serialized_script_source(JsSourceContext script_id);
+
     Var call_function(Var fn, const std::vector<Var>& args = {}) {
+      return call_function(fn, args.data(), args.size());
+    }
+
+    Var call_function(Var fn, const Var* args, size_t count) {
       Var result;
-      if (args.empty()) {
+      if (count == 0) {
         Var arg = undefined();
         _checked(JsCallFunction(fn, &arg, 1, &result));
       } else {
-        Var* args_ptr = const_cast<Var*>(args.data());
-        auto count = static_cast<unsigned short>(args.size());
-        _checked(JsCallFunction(fn, args_ptr, count, &result));
+        Var* args_ptr = const_cast<Var*>(args);
+        auto arg_count = static_cast<unsigned short>(count);
+        _checked(JsCallFunction(fn, args_ptr, arg_count, &result));
       }
       return result;
     }
@@ -326,16 +903,28 @@ namespace js {
       return result;
     }
 
+    template<typename T, typename F>
+    Var create_array(const std::vector<T>& values, F map);
+
     Var create_number(int value) {
       Var result;
       JsIntToNumber(value, &result);
       return result;
     }
 
-    JsPropertyIdRef create_property_id(const std::string& name) {
-      JsPropertyIdRef id;
-      JsCreatePropertyId(name.c_str(), name.length(), &id);
-      return id;
+    Var create_number(double value) {
+      Var result;
+      JsDoubleToNumber(value, &result);
+      return result;
+    }
+
+    JsPropertyIdRef create_property_id(std::string_view name) {
+      return _realm_info.property_ids->get(name);
+    }
+
+    template<const char* Name>
+    JsPropertyIdRef create_property_id() {
+      return _realm_info.property_ids->get<Name>();
     }
 
     Var create_string(const char* buffer) {
@@ -367,14 +956,32 @@ namespace js {
       return func;
     }
 
-    Var get_property(Var object, const std::string& name) {
+    Var get_property(Var object, JsPropertyIdRef id) {
       Var result;
-      _checked(JsGetProperty(object, create_property_id(name), &result));
+      _checked(JsGetProperty(object, id, &result));
       return result;
     }
 
-    void set_property(Var object, const std::string& name, Var value) {
-      _checked(JsSetProperty(object, create_property_id(name), value, true));
+    Var get_property(Var object, std::string_view name) {
+      return get_property(object, create_property_id(name));
+    }
+
+    template<const char* Name>
+    Var get_property(Var object) {
+      return get_property(object, create_property_id<Name>());
+    }
+
+    void set_property(Var object, JsPropertyIdRef id, Var value) {
+      _checked(JsSetProperty(object, id, value, true));
+    }
+
+    void set_property(Var object, std::string_view name, Var value) {
+      set_property(object, create_property_id(name), value);
+    }
+
+    template<const char* Name>
+    void set_property(Var object, Var value) {
+      set_property(object, create_property_id<Name>(), value);
     }
 
     Var get_indexed_property(Var object, Var index) {
@@ -396,15 +1003,80 @@ namespace js {
     }
 
     Var undefined() {
-      Var value;
-      JsGetUndefinedValue(&value);
-      return value;
+      return _realm_info.undefined_value;
+    }
+
+    Var null_value() {
+      return _realm_info.null_value;
+    }
+
+    Var true_value() {
+      return _realm_info.true_value;
+    }
+
+    Var false_value() {
+      return _realm_info.false_value;
+    }
+
+    Var create_boolean(bool value) {
+      return value ? true_value() : false_value();
     }
 
     Var global_object() {
-      Var global;
-      JsGetGlobalObject(&global);
-      return global;
+      return _realm_info.global_object;
+    }
+
+    // Creates an ArrayBuffer that uses memory owned by the caller. The
+    // finalizer is called with `state` when the buffer is collected.
+    Var create_external_array_buffer(
+      void* data,
+      size_t length,
+      JsFinalizeCallback finalize,
+      void* state)
+    {
+      Var result;
+      _checked(JsCreateExternalArrayBuffer(
+        data,
+        static_cast<unsigned>(length),
+        finalize,
+        state,
+        &result));
+      return result;
+    }
+
+    // Gets the backing memory of an ArrayBuffer, typed array or DataView.
+    // Returns false if the value is not one of those types.
+    bool get_buffer_storage(Var value, uint8_t*& data, size_t& length) {
+      unsigned byte_length = 0;
+      switch (value_type(value)) {
+        case JsArrayBuffer:
+          _checked(JsGetArrayBufferStorage(value, &data, &byte_length));
+          break;
+        case JsTypedArray: {
+          JsTypedArrayType array_type;
+          int element_size;
+          _checked(JsGetTypedArrayStorage(
+            value,
+            &data,
+            &byte_length,
+            &array_type,
+            &element_size));
+          break;
+        }
+        case JsDataView:
+          _checked(JsGetDataViewStorage(value, &data, &byte_length));
+          break;
+        default:
+          return false;
+      }
+      length = byte_length;
+      return true;
+    }
+
+    JsValueType value_type(Var value) {
+      JsValueType type;
+      _checked(JsGetValueType(value, &type));
+      return type;
     }
 
     bool is_null_or_undefined(Var value) {
@@ -432,87 +1104,140 @@ namespace js {
       return static_cast<I>(i);
     }
 
-    std::string utf8_string(Var value) {
-      Var string_value = to_string(value);
-      size_t length;
-      _checked(JsCopyString(string_value, nullptr, 0, &length));
+    // Copies the UTF-8 encoding of a value into a buffer. The buffer is
+    // first sized for an ASCII string, which is copied with a single call.
+    // Other strings are measured and copied again.
+    template<typename Buffer>
+    void copy_utf8(Var value, Buffer& buffer) {
+      int length;
+      // Values that are already strings are not converted
+      if (JsGetStringLength(value, &length) != JsNoError) {
+        value = to_string(value);
+        _checked(JsGetStringLength(value, &length));
+      }
+
       // TODO: Can we provide a buffer without initializing?
+      buffer.resize(static_cast<size_t>(length));
+      size_t written;
+      _checked(JsCopyString(value, buffer.data(), buffer.size(), &written));
+      if (written == buffer.size() && text::is_ascii(buffer.data(), written)) {
+        return;
+      }
+
       // TODO: [CC] Too many conversions between CC's internal string data and UTF8
+      _checked(JsCopyString(value, nullptr, 0, &written));
+      buffer.resize(written);
+      _checked(JsCopyString(value, buffer.data(), written, nullptr));
+    }
+
+    std::string utf8_string(Var value) {
       std::string buffer;
-      buffer.resize(length);
-      _checked(JsCopyString(string_value, buffer.data(), length, nullptr));
+      copy_utf8(value, buffer);
       return buffer;
     }
 
-    void enqueue_job(Job& job) {
-      _realm_info.job_queue->enqueue(std::move(job));
+    // Returns the UTF-8 encoding of a value, stored in a per-realm scratch
+    // buffer. The view is only valid until the next call to utf8_view.
+    std::string_view utf8_view(Var value) {
+      auto& buffer = _realm_info.utf8_scratch;
+      copy_utf8(value, buffer);
+      return {buffer.data(), buffer.size()};
     }
 
-    void enqueue_job(Var func, std::vector<Var>&& args) {
-      _realm_info.job_queue->enqueue(Job {
-        JobKind::call,
-        func,
-        std::move(args),
-      });
+    void enqueue_job(Job&& job, JobLane lane = JobLane::microtask) {
+      _realm_info.job_queue->enqueue(std::move(job), lane);
+    }
+
+    void enqueue_job(
+      Var func,
+      std::initializer_list<Var> args,
+      JobLane lane = JobLane::microtask)
+    {
+      _realm_info.job_queue->enqueue(Job {JobKind::call, func, args}, lane);
     }
 
     void enqueue_job(Var func) {
       _realm_info.job_queue->enqueue(Job {JobKind::call, func});
     }
 
-    void flush_job_queue() {
-      _realm_info.job_queue->flush();
+    bool flush_job_queue() {
+      return _realm_info.job_queue->flush();
+    }
+
+    bool has_pending_jobs() {
+      return !_realm_info.job_queue->empty();
     }
 
+    const JobQueueStats& job_queue_stats() {
+      return _realm_info.job_queue->stats();
+    }
+
+    const RejectionTracker& rejection_tracker() {
+      return _realm_info.rejections;
+    }
+
+    void track_rejection(Var promise, Var reason) {
+      _realm_info.rejections.add(promise, reason);
+    }
+
+    void untrack_rejection(Var promise) {
+      _realm_info.rejections.remove(promise);
+    }
+
+    bool has_unhandled_rejections() {
+      return !_realm_info.rejections.empty();
+    }
+
+    // Throws the reason for the oldest unhandled rejection, if any
+    void report_unhandled_rejections();
+
     // ## MODULES
 
     ModuleInfo* find_module_info(Var module) {
-      auto& module_info = _realm_info.module_info;
-      if (auto p = module_info.find(module); p != module_info.end()) {
-        return &p->second;
-      }
-      return nullptr;
+      auto p = _realm_info.module_info.find(module);
+      return p ? *p : nullptr;
     }
 
-    Var find_module_record(const std::string& url) {
-      auto& module_map = _realm_info.module_map;
-      if (auto p = module_map.find(url); p != module_map.end()) {
-        return p->second.var();
-      } else {
+    Var find_module_record(std::string_view url) {
+      UrlId id = _realm_info.urls.find(url);
+      if (id == UrlTable::none) {
         return nullptr;
       }
+      auto p = _realm_info.module_map.find(id);
+      return p ? (*p)->record.var() : nullptr;
     }
 
     Var find_module_record(Var url_string) {
       return find_module_record(utf8_string(url_string));
     }
 
+    // Resolves a specifier against a base URL (or UrlTable::none) and
+    // returns the module record for the resulting URL
     JsModuleRecord resolve_module_specifier(
       Var specifier,
-      const URLInfo* base_url,
+      UrlId base,
       JsModuleRecord importer = nullptr);
 
     JsModuleRecord resolve_module(
       JsModuleRecord importer,
       Var specifier)
     {
-      URLInfo* base_url = nullptr;
+      UrlId base = UrlTable::none;
       if (auto* info = find_module_info(importer)) {
-        base_url = &info->url;
+        base = info->url;
       }
-      return resolve_module_specifier(specifier, base_url, importer);
+      return resolve_module_specifier(specifier, base, importer);
     }
 
     JsModuleRecord resolve_module_from_script(
       JsSourceContext script_id,
       Var specifier)
     {
-      const URLInfo* base_url = nullptr;
-      auto& script_urls = _realm_info.script_urls;
-      if (auto p = script_urls.find(script_id); p != script_urls.end()) {
-        base_url = &p->second;
+      UrlId base = UrlTable::none;
+      if (auto p = _realm_info.script_urls.find(script_id)) {
+        base = *p;
       }
-      return resolve_module_specifier(specifier, base_url);
+      return resolve_module_specifier(specifier, base);
     }
 
     void set_module_load_callback(Var callback) {
@@ -525,6 +1250,41 @@ namespace js {
 
     void set_module_source(Var module, Var error, Var source);
 
+    void set_module_source(Var module, std::string&& source);
+
+    void load_file_module(Var module, UrlId url);
+
+    // Serves module imports from a bundle before falling back to the
+    // module loaders
+    void set_module_bundle(std::shared_ptr<const bundle::Bundle> bundle) {
+      _realm_info.bundle = std::move(bundle);
+    }
+
+    void set_module_prefetcher(std::shared_ptr<ModulePrefetcher> prefetcher) {
+      _realm_info.module_prefetcher = std::move(prefetcher);
+    }
+
+    void set_module_tracer(std::shared_ptr<ModuleTracer> tracer) {
+      _realm_info.module_tracer = std::move(tracer);
+    }
+
+    void set_module_recording(bool enabled) {
+      _realm_info.record_modules = enabled;
+    }
+
+    // Calls `fn(url, source, state)` for each module imported while
+    // recording. Modules that were parsed successfully are in the
+    // initializing state; others failed to load or parse.
+    template<typename F>
+    void each_recorded_module(F fn) {
+      for (auto& info : _realm_info.modules) {
+        std::string_view source = info.bundled_source.empty()
+          ? std::string_view {info.source_text}
+          : info.bundled_source;
+        fn(_realm_info.urls.url(info.url), source, info.state);
+      }
+    }
+
     void parse_module(Var module);
 
     void evaluate_module(Var module, Var error);
@@ -532,16 +1292,70 @@ namespace js {
     void initialize_import_meta(Var module, Var meta_object) {
       Var url_string;
       JsGetModuleHostInfo(module, JsModuleHostInfo_Url, &url_string);
-      set_property(meta_object, "url", url_string);
+      set_property<names::url>(meta_object, url_string);
     }
 
   };
 
+  // Builds an array by passing elements to Array.prototype.push in chunks,
+  // rather than creating an index value and setting each element with a
+  // separate call. Pending elements are kept in the builder itself, which
+  // must live on the stack so that the GC can find them.
+  struct ArrayBuilder {
+    static constexpr unsigned chunk_size = 256;
+
+    RealmAPI& _api;
+    Var _array;
+    // The first slot holds the receiver for push
+    Var _chunk[chunk_size + 1];
+    unsigned _count = 0;
+
+    explicit ArrayBuilder(RealmAPI& api) : _api {api} {
+      _array = _api.create_array();
+      _chunk[0] = _array;
+    }
+
+    ArrayBuilder(const ArrayBuilder& other) = delete;
+    ArrayBuilder& operator=(const ArrayBuilder& other) = delete;
+
+    void push(Var value) {
+      _chunk[++_count] = value;
+      if (_count == chunk_size) {
+        flush();
+      }
+    }
+
+    void flush() {
+      if (_count > 0) {
+        Var push_fn = _api._realm_info.array_push.var();
+        _api.call_function(push_fn, _chunk, _count + 1);
+        _count = 0;
+      }
+    }
+
+    Var finish() {
+      flush();
+      return _array;
+    }
+  };
+
+  template<typename T, typename F>
+  Var RealmAPI::create_array(const std::vector<T>& values, F map) {
+    ArrayBuilder builder {*this};
+    for (auto& value : values) {
+      builder.push(map(value));
+    }
+    return builder.finish();
+  }
+
   struct Realm {
     JsContextRef _context;
     RealmInfo _info;
 
-    Realm(JsContextRef context, std::shared_ptr<JobQueue>& job_queue);
+    Realm(
+      JsContextRef context,
+      std::shared_ptr<JobQueue>& job_queue,
+      std::shared_ptr<PropertyIdTable>& property_ids);
 
     Realm(const Realm& other) = delete;
     Realm& operator=(const Realm& other) = delete;
@@ -552,6 +1366,9 @@ namespace js {
     {
       JsSetContextData(_context, this);
       other._context = nullptr;
+      if (_current == &other) {
+        _current = this;
+      }
     }
 
     Realm& operator=(Realm&& other) {
@@ -561,6 +1378,9 @@ namespace js {
 
         JsSetContextData(_context, this);
         other._context = nullptr;
+        if (_current == &other) {
+          _current = this;
+        }
       }
       return *this;
     }
@@ -569,6 +1389,9 @@ namespace js {
       if (_context != nullptr) {
         JsSetContextData(_context, nullptr);
       }
+      if (_current == this) {
+        _current = nullptr;
+      }
     }
 
     RealmInfo& info() {
@@ -579,13 +1402,24 @@ namespace js {
       return _info;
     }
 
+    // The realm whose context was most recently entered. Contexts are
+    // only switched through Realm::enter, so this mirrors the engine's
+    // current context without a JSRT call.
+    inline static Realm* _current = nullptr;
+
     template<typename F>
     auto enter(F fn) {
-      JsContextRef current = nullptr;
-      JsGetCurrentContext(&current);
+      if (_current == this) {
+        return fn(RealmAPI {_info});
+      }
+      JsContextRef previous_context = nullptr;
+      JsGetCurrentContext(&previous_context);
       JsSetCurrentContext(_context);
+      Realm* previous = _current;
+      _current = this;
       auto cleanup = on_scope_exit([=]() {
-        JsSetCurrentContext(current);
+        JsSetCurrentContext(previous_context);
+        _current = previous;
       });
       return fn(RealmAPI {_info});
     }
@@ -600,14 +1434,15 @@ namespace js {
     }
 
     static Realm* current() {
-      JsContextRef context;
-      JsGetCurrentContext(&context);
-      return Realm::from_context_ref(context);
+      return _current;
     }
 
     static Realm* from_object(Var object) {
       JsContextRef context = nullptr;
       JsGetContextOfObject(object, &context);
+      if (_current && _current->_context == context) {
+        return _current;
+      }
       return Realm::from_context_ref(context);
     }
 
@@ -645,6 +1480,164 @@ namespace js {
     }
   };
 
+  // Argument types for typed native functions that require a specific
+  // kind of JS value
+  struct Callback {
+    Var value;
+    operator Var() const { return value; }
+  };
+
+  struct Object {
+    Var value;
+    operator Var() const { return value; }
+  };
+
+  // Converts a JS argument value to a C++ parameter type, throwing a
+  // TypeError if the value has the wrong type
+  template<typename T, typename Enable = void>
+  struct ArgConverter;
+
+  inline void throw_argument_error(RealmAPI& api, unsigned index, const char* expected) {
+    api.throw_exception(api.create_type_error(
+      "Argument " + std::to_string(index) + " must be " + expected));
+  }
+
+  template<>
+  struct ArgConverter<Var> {
+    static Var convert(RealmAPI& api, Var value, unsigned index) {
+      return value;
+    }
+  };
+
+  template<>
+  struct ArgConverter<bool> {
+    static bool convert(RealmAPI& api, Var value, unsigned index) {
+      bool result;
+      if (JsBooleanToBool(value, &result) != JsNoError) {
+        throw_argument_error(api, index, "a boolean");
+      }
+      return result;
+    }
+  };
+
+  template<typename T>
+  struct ArgConverter<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>> {
+    static T convert(RealmAPI& api, Var value, unsigned index) {
+      double number;
+      if (JsNumberToDouble(value, &number) != JsNoError) {
+        throw_argument_error(api, index, "a number");
+      }
+      if constexpr (std::is_integral_v<T>) {
+        // Fractional values are truncated toward zero, as timer delays
+        // and sizes computed in JS are often not whole numbers. NaN and
+        // values that do not fit in T are rejected. The upper bound is
+        // the power of two above T's maximum, which is exact as a double;
+        // the maximum itself may round up and let the cast overflow.
+        constexpr double min = static_cast<double>(std::numeric_limits<T>::min());
+        constexpr double limit = static_cast<double>(std::numeric_limits<T>::max() / 2 + 1) * 2;
+        number = std::trunc(number);
+        if (!(number >= min && number < limit)) {
+          throw_argument_error(api, index, "a number in range");
+        }
+      }
+      return static_cast<T>(number);
+    }
+  };
+
+  template<>
+  struct ArgConverter<std::string> {
+    static std::string convert(RealmAPI& api, Var value, unsigned index) {
+      if (api.value_type(value) != JsString) {
+        throw_argument_error(api, index, "a string");
+      }
+      return api.utf8_string(value);
+    }
+  };
+
+  template<>
+  struct ArgConverter<Callback> {
+    static Callback convert(RealmAPI& api, Var value, unsigned index) {
+      if (api.value_type(value) != JsFunction) {
+        throw_argument_error(api, index, "a function");
+      }
+      return {value};
+    }
+  };
+
+  template<>
+  struct ArgConverter<Object> {
+    static Object convert(RealmAPI& api, Var value, unsigned index) {
+      switch (api.value_type(value)) {
+        case JsUndefined:
+        case JsNull:
+        case JsNumber:
+        case JsString:
+        case JsBoolean:
+        case JsSymbol:
+          throw_argument_error(api, index, "an object");
+          break;
+        default:
+          break;
+      }
+      return {value};
+    }
+  };
+
+  // Host object data, as created by RealmAPI::create_host_object
+  template<typename T>
+  struct ArgConverter<T*, std::enable_if_t<!std::is_void_v<T>>> {
+    static T* convert(RealmAPI& api, Var value, unsigned index) {
+      T* data = nullptr;
+      if (api.value_type(value) == JsObject) {
+        data = api.get_host_object_data<T>(value);
+      }
+      if (!data) {
+        api.throw_exception(api.create_type_error(
+          std::string {"Not a valid "} + T::description));
+      }
+      return data;
+    }
+  };
+
+  template<typename R, typename... Params, size_t... I>
+  Var call_with_args(
+    RealmAPI& api,
+    CallArgs& args,
+    R (*fn)(RealmAPI&, Params...),
+    std::index_sequence<I...>)
+  {
+    // Arguments are converted left to right. Argument 0 is the receiver.
+    std::tuple<std::decay_t<Params>...> values {
+      ArgConverter<std::decay_t<Params>>::convert(
+        api,
+        args[I + 1],
+        static_cast<unsigned>(I + 1))...
+    };
+    if constexpr (std::is_void_v<R>) {
+      fn(api, std::get<I>(values)...);
+      return api.undefined();
+    } else {
+      return fn(api, std::get<I>(values)...);
+    }
+  }
+
+  // A native function whose arguments are unpacked from a plain C++
+  // signature. The derived type provides a static `invoke` function, e.g.
+  //
+  //   static Var invoke(RealmAPI& api, uint64_t timeout, Callback callback)
+  //
+  template<typename T>
+  struct TypedNativeFunc : public NativeFunc {
+    static Var call(RealmAPI& api, CallArgs& args) {
+      return call_impl(api, args, &T::invoke);
+    }
+
+    template<typename R, typename... Params>
+    static Var call_impl(RealmAPI& api, CallArgs& args, R (*fn)(RealmAPI&, Params...)) {
+      return call_with_args(api, args, fn, std::index_sequence_for<Params...> {});
+    }
+  };
+
   template<typename T>
   Var CHAKRA_CALLBACK native_func_callback(
     Var callee,
@@ -685,10 +1678,12 @@ namespace js {
   struct Engine {
     JsRuntimeHandle _runtime;
     std::shared_ptr<JobQueue> _job_queue;
+    std::shared_ptr<PropertyIdTable> _property_ids;
 
     Engine() {
       _checked(JsCreateRuntime(JsRuntimeAttributeNone, nullptr, &_runtime));
       _job_queue = std::make_shared<JobQueue>();
+      _property_ids = std::make_shared<PropertyIdTable>();
     }
 
     Engine(const Engine& other) = delete;
@@ -697,6 +1692,7 @@ namespace js {
     Engine(Engine&& other) {
       _runtime = other._runtime;
       _job_queue = other._job_queue;
+      _property_ids = other._property_ids;
       other._runtime = JS_INVALID_RUNTIME_HANDLE;
     }
 
@@ -704,6 +1700,7 @@ namespace js {
       if (this != &other) {
         _runtime = other._runtime;
         _job_queue = std::move(other._job_queue);
+        _property_ids = std::move(other._property_ids);
         other._runtime = JS_INVALID_RUNTIME_HANDLE;
       }
       return *this;
@@ -720,11 +1717,15 @@ namespace js {
     Realm create_realm() {
       JsContextRef context;
       _checked(JsCreateContext(_runtime, &context));
-      return Realm {context, _job_queue};
+      return Realm {context, _job_queue, _property_ids};
+    }
+
+    bool flush_job_queue() {
+      return _job_queue->flush();
     }
 
-    void flush_job_queue() {
-      _job_queue->flush();
+    void set_flush_budget(const FlushBudget& budget) {
+      _job_queue->set_budget(budget);
     }
 
   };
@@ -744,7 +1745,7 @@ namespace js {
 
   template<typename F>
   inline auto enter_object_realm(Var obj, F fn) {
-    return fn(RealmAPI {Realm::from_object(obj)->info()});
+    return Realm::from_object(obj)->enter(fn);
   }
 
 }
@@ -1,18 +1,26 @@
+#include <vector>
+#include <cerrno>
+#include <cstdlib>
+
 #include "common.h"
 #include "js_engine.h"
 #include "sys_object.h"
 #include "event_loop.h"
+#include "bundle.h"
+#include "module_trace.h"
+#include "module_prefetch.h"
 #include "main.js.h"
+#include "main.js.bc.h"
 
 template<typename T>
 void print_error(T& out, js::RealmAPI& api) {
   auto info = api.pop_exception_info();
-  auto exception = api.get_property(info, "exception");
-  auto stack_string = api.get_property(exception, "stack");
-  auto url_string = api.get_property(info, "url");
-  auto line = api.get_property(info, "line");
-  auto column = api.get_property(info, "column");
-  auto source = api.get_property(info, "source");
+  auto exception = api.get_property<js::names::exception>(info);
+  auto stack_string = api.get_property<js::names::stack>(exception);
+  auto url_string = api.get_property<js::names::url>(info);
+  auto line = api.get_property<js::names::line>(info);
+  auto column = api.get_property<js::names::column>(info);
+  auto source = api.get_property<js::names::source>(info);
 
   if (stack_string == api.undefined()) {
     stack_string = api.to_string(exception);
@@ -38,18 +46,189 @@ void print_error(T& out, js::RealmAPI& api) {
   }
 }
 
+struct RuntimeOptions {
+  event_loop::DispatchMode dispatch_mode = event_loop::DispatchMode::coalesced;
+  js::FlushBudget flush_budget;
+  std::string module_trace_path;
+  bool module_manifest = false;
+};
+
+// Thrown for a runtime option with an invalid value
+struct UsageError {
+  std::string message;
+};
+
+bool parse_option_value(const std::string& arg, const std::string& name, uint64_t& value) {
+  if (arg.compare(0, name.length(), name) != 0) {
+    return false;
+  }
+  // The value must be a non-empty string of decimal digits
+  const char* start = arg.c_str() + name.length();
+  char* end = nullptr;
+  errno = 0;
+  value = std::strtoull(start, &end, 10);
+  if (*start < '0' || *start > '9' || *end != '\0' || errno == ERANGE) {
+    throw UsageError {"invalid value for " + arg.substr(0, name.length() - 1) + ": " + start};
+  }
+  return true;
+}
+
+bool parse_option_value(const std::string& arg, const std::string& name, std::string& value) {
+  if (arg.compare(0, name.length(), name) != 0) {
+    return false;
+  }
+  value = arg.substr(name.length());
+  return true;
+}
+
+bool parse_runtime_option(RuntimeOptions& options, const std::string& arg) {
+  uint64_t value;
+  if (arg == "--zoe-dispatch=immediate") {
+    options.dispatch_mode = event_loop::DispatchMode::immediate;
+  } else if (arg == "--zoe-dispatch=coalesced") {
+    options.dispatch_mode = event_loop::DispatchMode::coalesced;
+  } else if (arg == "--zoe-module-manifest") {
+    options.module_manifest = true;
+  } else if (parse_option_value(arg, "--zoe-job-budget=", value)) {
+    options.flush_budget.max_jobs = static_cast<size_t>(value);
+  } else if (parse_option_value(arg, "--zoe-job-budget-ms=", value)) {
+    options.flush_budget.max_time_ns = value * 1000000;
+  } else if (!parse_option_value(arg, "--zoe-trace-modules=", options.module_trace_path)) {
+    return false;
+  }
+  return true;
+}
+
+// Removes runtime options from the argument list
+std::vector<char*> parse_runtime_options(
+  RuntimeOptions& options,
+  int arg_count,
+  char** args)
+{
+  std::vector<char*> script_args;
+  for (int i = 0; i < arg_count; ++i) {
+    if (i == 0 || !parse_runtime_option(options, args[i])) {
+      script_args.push_back(args[i]);
+    }
+  }
+  return script_args;
+}
+
+void write_bundle(js::RealmAPI& api, const std::string& path, const std::string& main_path) {
+  auto cwd_url = URLInfo::from_file_path(os::cwd() + "/");
+  auto main_url = URLInfo::stringify(URLInfo::from_file_path(main_path, &cwd_url));
+  std::vector<bundle::Module> modules;
+  api.each_recorded_module([&](auto& url, auto source, auto state) {
+    // A bundle is not written for a program with modules that failed
+    if (state != js::ModuleState::initializing) {
+      throw os::Error {"Unable to bundle module (" + url + ")", "EINVAL"};
+    }
+    modules.push_back({url, source});
+  });
+  bundle::write(path, main_url, modules);
+}
+
 int main(int arg_count, char** args) {
+  RuntimeOptions options;
+  std::vector<char*> script_args;
+  try {
+    script_args = parse_runtime_options(options, arg_count, args);
+  } catch (const UsageError& error) {
+    std::cout << "usage: " << error.message << "\n";
+    return 1;
+  }
+  event_loop::set_dispatch_mode(options.dispatch_mode);
+
+  // `zoe bundle filename output` records the import graph of a program
+  // and writes it to a bundle file, without running the program
+  std::string bundle_output;
+  if (script_args.size() > 1 && std::string {script_args[1]} == "bundle") {
+    if (script_args.size() < 4) {
+      std::cout << "usage: zoe bundle filename output\n";
+      return 1;
+    }
+    bundle_output = script_args[3];
+    script_args = {script_args[0], script_args[2]};
+  }
+
+  std::shared_ptr<const bundle::Bundle> module_bundle;
+  std::string bundle_main_path;
+  if (
+    bundle_output.empty() &&
+    script_args.size() > 1 &&
+    bundle::has_bundle_extension(script_args[1]))
+  {
+    try {
+      module_bundle = bundle::Bundle::open(script_args[1]);
+    } catch (const os::Error& error) {
+      std::cout << error.message << "\n";
+      return 1;
+    }
+    // The main module is given the URL it would have next to the bundle
+    bundle_main_path = URLInfo::to_file_path(URLInfo::parse(module_bundle->main_url()));
+    script_args[1] = bundle_main_path.data();
+  }
+
   js::Engine engine;
+  engine.set_flush_budget(options.flush_budget);
   js::Realm realm = engine.create_realm();
   int error_code = 0;
 
+  // With --zoe-module-manifest, modules recorded in the entry point's
+  // manifest are read up front and the manifest is updated after the run
+  std::shared_ptr<js::ModulePrefetcher> module_prefetcher;
+  if (
+    options.module_manifest &&
+    !module_bundle &&
+    bundle_output.empty() &&
+    script_args.size() > 1)
+  {
+    module_prefetcher = std::make_shared<js::ModulePrefetcher>();
+  }
+
+  std::shared_ptr<js::ModuleTracer> module_tracer;
+  if (!options.module_trace_path.empty()) {
+    module_tracer = std::make_shared<js::ModuleTracer>();
+  }
+
   realm.enter([&](auto& api) {
 
     try {
 
-      auto sys = sys_object::create(api, arg_count, args);
-      auto source = api.create_string(main_js);
-      auto result = api.eval(source, "zoe:main");
+      if (module_bundle) {
+        api.set_module_bundle(module_bundle);
+      }
+
+      if (module_tracer) {
+        api.set_module_tracer(module_tracer);
+      }
+
+      if (module_prefetcher) {
+        api.set_module_prefetcher(module_prefetcher);
+        module_prefetcher->start(script_args[1]);
+      }
+
+      if (!bundle_output.empty()) {
+        api.set_module_recording(true);
+      }
+
+      auto sys = sys_object::create(
+        api,
+        static_cast<int>(script_args.size()),
+        script_args.data());
+
+      // The bootstrap script is precompiled at build time. If the engine
+      // rejects the bytecode, fall back to parsing the embedded source.
+      auto result = api.run_serialized(
+        main_js_bytecode,
+        sizeof(main_js_bytecode),
+        main_js,
+        "zoe:main");
+
+      if (!result) {
+        result = api.eval(api.create_string(main_js), "zoe:main");
+      }
+
       auto callbacks = api.call_function(result, {api.undefined(), sys});
 
       auto load_module = api.get_property(callbacks, "loadModule");
@@ -60,15 +239,37 @@ int main(int arg_count, char** args) {
 
       event_loop::run();
 
+      if (!bundle_output.empty()) {
+        write_bundle(api, bundle_output, script_args[1]);
+      }
+
+      if (module_prefetcher) {
+        module_prefetcher->save();
+      }
+
     } catch (const js::ScriptError&) {
 
       error_code = 1;
       print_error(std::cout, api);
 
+    } catch (const os::Error& error) {
+
+      error_code = 1;
+      std::cout << error.message << "\n";
+
     }
 
   });
 
+  // The trace is written even if the program failed
+  if (module_tracer) {
+    try {
+      module_tracer->write(options.module_trace_path);
+    } catch (const os::Error& error) {
+      std::cout << error.message << "\n";
+    }
+  }
+
   // TODO: Unique error codes?
   return error_code;
 }
@@ -17,11 +17,12 @@ static const std::string main_js = u8R"js(
   };
 
   function loadModule(url, callback) {
-    try {
-      callback(null, sys.readTextFileSync(url));
-    } catch (err) {
-      callback(new Error(`Unable to load module (${ url })`));
-    }
+    // Module sources are read on the thread pool, so that sibling
+    // imports are fetched concurrently
+    sys.readTextFile(url, (err, source) => {
+      if (err) callback(new Error(`Unable to load module (${ url })`));
+      else callback(null, source);
+    });
   }
 
   function main() {
@@ -29,12 +30,13 @@ static const std::string main_js = u8R"js(
       print('zoe - A modern JavaScript runtime');
       print('');
       print('usage: zoe filename');
+      print('       zoe bundle filename output');
       return;
     }
 
     let i = sys.args.indexOf('--zoe-test-sys-api');
     if (i >= 0) {
-      hostAPI.sys = sys;
+      hostAPI.sys = sys.installAll();
       sys.args.splice(i, 1);
     }
 
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "module_prefetch.h"
+
+namespace js {
+
+  namespace {
+
+    using Entry = ModulePrefetcher::Entry;
+
+    void on_prefetch_done(Entry* entry) {
+      entry->done = true;
+      if (entry->waiting_module) {
+        enter_current_realm([&](auto& api) {
+          ModulePrefetcher::deliver(api, *entry);
+        });
+      }
+    }
+
+    struct PrefetchCallback {
+      static void on_success(std::string& content, void* data) {
+        auto* entry = reinterpret_cast<Entry*>(data);
+        entry->content = std::move(content);
+        on_prefetch_done(entry);
+      }
+
+      static void on_error(const os::Error& error, void* data) {
+        auto* entry = reinterpret_cast<Entry*>(data);
+        entry->failed = true;
+        on_prefetch_done(entry);
+      }
+    };
+
+  }
+
+  void ModulePrefetcher::start(const std::string& entry_path) {
+    _manifest_path = entry_path + ".zoe-manifest";
+
+    std::string text;
+    try {
+      _entry_stat = os::stat_file_sync(entry_path);
+      text = os::read_text_file_sync(_manifest_path);
+    } catch (const os::Error&) {
+      return;
+    }
+
+    std::istringstream in {text};
+    std::string header;
+    os::FileStat recorded;
+    std::getline(in, header);
+    in >> recorded.size >> recorded.modified_time_ns;
+
+    // A manifest recorded for a different version of the entry point
+    // is stale
+    if (
+      !in ||
+      header != "zoe-manifest 1" ||
+      recorded.size != _entry_stat.size ||
+      recorded.modified_time_ns != _entry_stat.modified_time_ns)
+    {
+      return;
+    }
+
+    size_t size;
+    std::string url;
+    while (in >> size && std::getline(in >> std::ws, url)) {
+      _manifest.emplace_back(url, size);
+    }
+
+    for (auto& [url, size] : _manifest) {
+      auto& entry = _entries.emplace_back(std::make_unique<Entry>());
+      entry->url = url;
+      _pending[entry->url] = entry.get();
+      os::read_text_file<PrefetchCallback>(
+        URLInfo::to_file_path(URLInfo::parse(url)),
+        entry.get());
+    }
+  }
+
+  bool ModulePrefetcher::claim(RealmAPI& api, const std::string& url, Var module) {
+    auto p = _pending.find(url);
+    if (p == _pending.end()) {
+      return false;
+    }
+    auto* entry = p->second;
+    _pending.erase(p);
+    entry->waiting_module = module;
+    if (entry->done) {
+      deliver(api, *entry);
+    }
+    return true;
+  }
+
+  void ModulePrefetcher::deliver(RealmAPI& api, Entry& entry) {
+    auto module = entry.waiting_module;
+    entry.waiting_module = nullptr;
+    if (entry.failed) {
+      auto message = "Unable to load module (" + entry.url + ")";
+      api.set_module_source(module, api.create_error(message), nullptr);
+    } else {
+      api.set_module_source(module, std::move(entry.content));
+    }
+  }
+
+  void ModulePrefetcher::save() {
+    auto recorded = _manifest;
+    auto loaded = _loaded;
+    std::sort(recorded.begin(), recorded.end());
+    std::sort(loaded.begin(), loaded.end());
+    if (recorded == loaded) {
+      return;
+    }
+
+    std::ofstream out {_manifest_path, std::ios::binary | std::ios::trunc};
+    out << "zoe-manifest 1\n";
+    out << _entry_stat.size << " " << _entry_stat.modified_time_ns << "\n";
+    for (auto& [url, size] : _loaded) {
+      out << size << " " << url << "\n";
+    }
+  }
+
+}
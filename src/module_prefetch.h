@@ -0,0 +1,61 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "js_engine.h"
+#include "os.h"
+
+namespace js {
+
+  // Reads the file modules listed in an import-graph manifest up front and
+  // in parallel, so that loading does not wait for the parser to discover
+  // each level of imports. The manifest is rewritten after a run that
+  // loaded a different set of modules.
+  //
+  // Manifest format:
+  //
+  //   zoe-manifest 1
+  //   <entry size> <entry modification time>
+  //   <size> <url>
+  //   ...
+  struct ModulePrefetcher {
+    struct Entry {
+      std::string url;
+      std::string content;
+      Var waiting_module = nullptr;
+      bool done = false;
+      bool failed = false;
+    };
+
+    std::string _manifest_path;
+    os::FileStat _entry_stat;
+    std::vector<std::unique_ptr<Entry>> _entries;
+    std::unordered_map<std::string_view, Entry*> _pending;
+    std::vector<std::pair<std::string, size_t>> _manifest;
+    std::vector<std::pair<std::string, size_t>> _loaded;
+
+    // Reads the manifest for an entry point and starts reading the listed
+    // modules. A missing manifest, or one recorded for a different version
+    // of the entry point, is ignored.
+    void start(const std::string& entry_path);
+
+    // Returns true if the module's source is being provided by a prefetch.
+    // The source is passed to `set_module_source` when it is available.
+    bool claim(RealmAPI& api, const std::string& url, Var module);
+
+    // Called for each file module that is loaded, in load order
+    void on_loaded(const std::string& url, size_t size) {
+      _loaded.emplace_back(url, size);
+    }
+
+    // Writes the manifest if the modules that were loaded differ from
+    // those that it lists. Errors are ignored.
+    void save();
+
+    static void deliver(RealmAPI& api, Entry& entry);
+  };
+
+}
@@ -0,0 +1,95 @@
+#include <fstream>
+
+#include "module_trace.h"
+#include "os.h"
+
+namespace js {
+
+  namespace {
+
+    void write_json_string(std::ostream& out, const std::string& value) {
+      static const char hex[] = "0123456789abcdef";
+      out << '"';
+      for (char c : value) {
+        if (c == '"' || c == '\\') {
+          out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+          out << "\\u00" << hex[(c >> 4) & 0xf] << hex[c & 0xf];
+        } else {
+          out << c;
+        }
+      }
+      out << '"';
+    }
+
+  }
+
+  void ModuleTracer::write(const std::string& path) {
+    std::ofstream out {path, std::ios::trunc};
+
+    // Trace timestamps are in microseconds
+    auto micros = [&](uint64_t time) {
+      return (time - _start_time) / 1000;
+    };
+
+    bool first = true;
+    auto begin_event = [&](const Timing& timing, const char* category, const char* phase) {
+      out << (first ? "\n" : ",\n") << "{\"name\":";
+      first = false;
+      write_json_string(out, timing.url);
+      out << ",\"cat\":\"" << category << "\",\"ph\":\"" << phase << "\",\"pid\":1";
+    };
+
+    // Loading and queueing overlap between modules, so they are written
+    // as async spans. Parsing and evaluation run on the main thread.
+    auto write_span = [&](const Timing& timing, size_t id, const char* category, uint64_t start, uint64_t end) {
+      if (start == 0 || end == 0) {
+        return;
+      }
+      begin_event(timing, category, "b");
+      out << ",\"tid\":1,\"id\":" << id << ",\"ts\":" << micros(start) << "}";
+      begin_event(timing, category, "e");
+      out << ",\"tid\":1,\"id\":" << id << ",\"ts\":" << micros(end) << "}";
+    };
+
+    out << "{\"traceEvents\":[";
+
+    for (size_t i = 0; i < _timings.size(); ++i) {
+      auto& timing = _timings[i];
+
+      write_span(timing, i, "load", timing.resolve_time, timing.load_time);
+      write_span(timing, i, "queue", timing.load_time, timing.parse_start_time);
+
+      if (timing.parse_end_time) {
+        begin_event(timing, "parse", "X");
+        out
+          << ",\"tid\":1,\"ts\":" << micros(timing.parse_start_time)
+          << ",\"dur\":" << micros(timing.parse_end_time) - micros(timing.parse_start_time)
+          << ",\"args\":{\"bytes\":" << timing.source_size << ",\"imports\":[";
+        for (size_t j = 0; j < timing.imports.size(); ++j) {
+          if (j > 0) {
+            out << ",";
+          }
+          auto p = _index.find(timing.imports[j]);
+          write_json_string(out, p ? _timings[*p].url : std::string {});
+        }
+        out << "]}}";
+      }
+
+      if (timing.evaluate_end_time) {
+        begin_event(timing, "evaluate", "X");
+        out
+          << ",\"tid\":1,\"ts\":" << micros(timing.evaluate_start_time)
+          << ",\"dur\":" << micros(timing.evaluate_end_time) - micros(timing.evaluate_start_time)
+          << "}";
+      }
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    if (!out) {
+      throw os::Error {"Unable to write module trace (" + path + ")", "EIO"};
+    }
+  }
+
+}
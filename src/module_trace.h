@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "js_engine.h"
+
+namespace js {
+
+  // Records per-module load timings, source sizes and import edges, and
+  // writes them as a Chrome trace-event file
+  struct ModuleTracer {
+    struct Timing {
+      std::string url;
+      uint64_t resolve_time = 0;
+      uint64_t load_time = 0;
+      uint64_t parse_start_time = 0;
+      uint64_t parse_end_time = 0;
+      uint64_t evaluate_start_time = 0;
+      uint64_t evaluate_end_time = 0;
+      size_t source_size = 0;
+      std::vector<UrlId> imports;
+    };
+
+    uint64_t _start_time = now();
+    IdMap<UrlId, size_t> _index;
+    std::vector<Timing> _timings;
+
+    static uint64_t now() { return uv_hrtime(); }
+
+    Timing* find(UrlId url) {
+      auto p = _index.find(url);
+      return p ? &_timings[*p] : nullptr;
+    }
+
+    void on_resolve(UrlId url, const std::string& url_string) {
+      _index[url] = _timings.size();
+      auto& timing = _timings.emplace_back();
+      timing.url = url_string;
+      timing.resolve_time = now();
+    }
+
+    void on_import(UrlId importer, UrlId url) {
+      if (auto* timing = find(importer)) {
+        timing->imports.push_back(url);
+      }
+    }
+
+    void on_load(UrlId url) {
+      if (auto* timing = find(url)) {
+        timing->load_time = now();
+      }
+    }
+
+    void on_parse_start(UrlId url, size_t source_size) {
+      if (auto* timing = find(url)) {
+        timing->source_size = source_size;
+        timing->parse_start_time = now();
+      }
+    }
+
+    void on_parse_end(UrlId url) {
+      if (auto* timing = find(url)) {
+        timing->parse_end_time = now();
+      }
+    }
+
+    void on_evaluate_start(UrlId url) {
+      if (auto* timing = find(url)) {
+        timing->evaluate_start_time = now();
+      }
+    }
+
+    void on_evaluate_end(UrlId url) {
+      if (auto* timing = find(url)) {
+        timing->evaluate_end_time = now();
+      }
+    }
+
+    // Writes the trace. Throws os::Error if the file cannot be written.
+    void write(const std::string& path);
+  };
+
+}
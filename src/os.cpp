@@ -1,11 +1,20 @@
 #include <utility>
+#include <algorithm>
 #include <string>
 #include <climits>
 #include <cstdlib>
+#include <cerrno>
 #include <unordered_set>
 
 #include "os.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace os {
 
 #ifdef _WIN32
@@ -28,6 +37,12 @@ namespace os {
     }
   }
 
+  // The initial buffer size for files of unknown size
+  constexpr size_t read_chunk_size = 64 * 1024;
+
+  // The largest read issued at once
+  constexpr size_t max_read_size = 1024 * 1024 * 1024;
+
   std::string cwd() {
     char buffer[PATH_MAX_BYTES];
     size_t cwd_len = sizeof(buffer);
@@ -35,6 +50,13 @@ namespace os {
     return {buffer};
   }
 
+  std::string temp_directory() {
+    char buffer[PATH_MAX_BYTES];
+    size_t length = sizeof(buffer);
+    _check_uv(uv_os_tmpdir(buffer, &length));
+    return {buffer, length};
+  }
+
   // Timers
 
   struct Timer {
@@ -134,39 +156,346 @@ namespace os {
 
   // File system
 
-  std::string read_text_file_sync(const std::string& path) {
+  void close_file_sync(uv_file file) {
+    uv_fs_t req;
+    uv_fs_close(nullptr, &req, file, nullptr);
+    uv_fs_req_cleanup(&req);
+  }
+
+  // Opens an existing file and returns its size
+  uv_file open_file_sync(const std::string& path, int flags, size_t& size) {
     uv_fs_t req;
 
-    // Open file
-    uv_file file = uv_fs_open(nullptr, &req, path.c_str(), UV_FS_O_RDONLY, 0, nullptr);
+    uv_file file = uv_fs_open(nullptr, &req, path.c_str(), flags, 0, nullptr);
     uv_fs_req_cleanup(&req);
     _check_uv(file);
 
-    char buffer_memory[4096];
-    uv_buf_t buffer = uv_buf_init(buffer_memory, sizeof(buffer_memory));
-    std::string str;
+    int result = uv_fs_fstat(nullptr, &req, file, nullptr);
+    size = static_cast<size_t>(req.statbuf.st_size);
+    uv_fs_req_cleanup(&req);
+    if (result < 0) {
+      close_file_sync(file);
+      throw error_from_uv_result(result);
+    }
+
+    return file;
+  }
+
+  uv_file open_file_for_read(const std::string& path, size_t& size) {
+    return open_file_sync(path, UV_FS_O_RDONLY, size);
+  }
+
+  FileStat file_stat_from_uv(const uv_stat_t& statbuf) {
+    FileStat stat;
+    stat.size = statbuf.st_size;
+    stat.modified_time_ns =
+      static_cast<uint64_t>(statbuf.st_mtim.tv_sec) * 1000000000 +
+      static_cast<uint64_t>(statbuf.st_mtim.tv_nsec);
+    return stat;
+  }
+
+  FileStat stat_file_sync(const std::string& path) {
+    uv_fs_t req;
+    int result = uv_fs_stat(nullptr, &req, path.c_str(), nullptr);
+    auto stat = file_stat_from_uv(req.statbuf);
+    uv_fs_req_cleanup(&req);
+    _check_uv(result);
+    return stat;
+  }
+
+  std::optional<FileStat> stat_file_if_exists_sync(const std::string& path) {
+    uv_fs_t req;
+    int result = uv_fs_stat(nullptr, &req, path.c_str(), nullptr);
+    auto stat = file_stat_from_uv(req.statbuf);
+    uv_fs_req_cleanup(&req);
+    if (result == UV_ENOENT || result == UV_ENOTDIR) {
+      return std::nullopt;
+    }
+    _check_uv(result);
+    return stat;
+  }
+
+  MappedFile& MappedFile::operator=(MappedFile&& other) {
+    if (this != &other) {
+      unmap();
+      data = other.data;
+      size = other.size;
+      _page_offset = other._page_offset;
+      other.data = nullptr;
+      other.size = 0;
+      other._page_offset = 0;
+#ifdef _WIN32
+      _mapping = other._mapping;
+      other._mapping = nullptr;
+#endif
+    }
+    return *this;
+  }
+
+  void MappedFile::unmap() {
+    if (!data) {
+      return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data - _page_offset);
+    CloseHandle(_mapping);
+    _mapping = nullptr;
+#else
+    munmap(data - _page_offset, size + _page_offset);
+#endif
+    data = nullptr;
+    size = 0;
+    _page_offset = 0;
+  }
+
+  // Mappings must start at a multiple of this size
+  size_t map_granularity() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+  }
+
+  MappedFile map_open_file(
+    uv_file file,
+    size_t size,
+    MapAccess access = MapAccess::read,
+    uint64_t offset = 0)
+  {
+    // Empty ranges cannot be mapped
+    MappedFile mapped;
+    if (size == 0) {
+      return mapped;
+    }
+
+    // The mapping starts at the page that contains the offset
+    size_t page_offset = static_cast<size_t>(offset % map_granularity());
+    uint64_t map_offset = offset - page_offset;
+    size_t map_size = size + page_offset;
+
+#ifdef _WIN32
+    HANDLE handle = reinterpret_cast<HANDLE>(uv_get_osfhandle(file));
+    DWORD protect =
+      access == MapAccess::write ? PAGE_READWRITE :
+      access == MapAccess::copy_on_write ? PAGE_WRITECOPY :
+      PAGE_READONLY;
+    HANDLE mapping = CreateFileMappingW(handle, nullptr, protect, 0, 0, nullptr);
+    if (!mapping) {
+      throw Error {"Unable to map file", "EIO"};
+    }
+    DWORD view_access =
+      access == MapAccess::write ? FILE_MAP_WRITE :
+      access == MapAccess::copy_on_write ? FILE_MAP_COPY :
+      FILE_MAP_READ;
+    void* view = MapViewOfFile(
+      mapping,
+      view_access,
+      static_cast<DWORD>(map_offset >> 32),
+      static_cast<DWORD>(map_offset & 0xffffffff),
+      map_size);
+    if (!view) {
+      CloseHandle(mapping);
+      throw Error {"Unable to map file", "EIO"};
+    }
+    mapped._mapping = mapping;
+#else
+    int protection = access == MapAccess::read ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = access == MapAccess::write ? MAP_SHARED : MAP_PRIVATE;
+    void* view = mmap(
+      nullptr,
+      map_size,
+      protection,
+      flags,
+      file,
+      static_cast<off_t>(map_offset));
+    if (view == MAP_FAILED) {
+      _check_uv(uv_translate_sys_error(errno));
+    }
+#endif
+
+    // The mapping remains valid after the file is closed
+    mapped.data = static_cast<uint8_t*>(view) + page_offset;
+    mapped.size = size;
+    mapped._page_offset = page_offset;
+    return mapped;
+  }
+
+  MappedFile map_file(const std::string& path, MapAccess access) {
+    int flags = access == MapAccess::write ? UV_FS_O_RDWR : UV_FS_O_RDONLY;
+    size_t size;
+    uv_file file = open_file_sync(path, flags, size);
+    auto cleanup = on_scope_exit([=]() { close_file_sync(file); });
+    return map_open_file(file, size, access);
+  }
+
+  MappedFile map_file(
+    const std::string& path,
+    MapAccess access,
+    uint64_t offset,
+    std::optional<uint64_t> length,
+    uint64_t max_length)
+  {
+    int flags = access == MapAccess::write ? UV_FS_O_RDWR : UV_FS_O_RDONLY;
+    size_t size;
+    uv_file file = open_file_sync(path, flags, size);
+    auto cleanup = on_scope_exit([=]() { close_file_sync(file); });
+
+    // Pages past the end of the file cannot be accessed
+    if (offset > size || (length && *length > size - offset)) {
+      throw Error {"Range is outside of the file", "EINVAL"};
+    }
+
+    uint64_t map_length = length ? *length : size - offset;
+    if (map_length > max_length || map_length > SIZE_MAX) {
+      throw Error {"File too large", "EFBIG"};
+    }
+
+    return map_open_file(file, static_cast<size_t>(map_length), access, offset);
+  }
+
+  // Reads an open file into a string or buffer, in as few reads as
+  // possible, and returns the number of bytes read. `resize` resizes the
+  // destination and returns its data. Files that report a size of zero
+  // (e.g. pipes and some special files) are read until end of file.
+  template<typename Resize>
+  size_t read_open_file(uv_file file, size_t size, Resize resize) {
+    size_t capacity = size > 0 ? size : read_chunk_size;
+    char* out = resize(capacity);
+    size_t offset = 0;
 
-    int bytes;
     while (true) {
-      // Read into buffer
-      bytes = uv_fs_read(nullptr, &req, file, &buffer, 1, str.length(), nullptr);
+      if (offset == capacity) {
+        if (size > 0) {
+          break;
+        }
+        capacity *= 2;
+        out = resize(capacity);
+      }
+
+      size_t length = std::min(capacity - offset, max_read_size);
+      uv_buf_t buffer = uv_buf_init(out + offset, static_cast<unsigned>(length));
+
+      // Files of unknown size may not be seekable, so they are read from
+      // the current position
+      int64_t position = size > 0 ? static_cast<int64_t>(offset) : -1;
+
+      uv_fs_t req;
+      int bytes = uv_fs_read(nullptr, &req, file, &buffer, 1, position, nullptr);
       uv_fs_req_cleanup(&req);
-      if (bytes > 0) {
-        str.append(buffer.base, bytes);
-      } else {
+      _check_uv(bytes);
+
+      if (bytes == 0) {
         break;
       }
+      offset += bytes;
     }
 
-    _check_uv(bytes);
+    resize(offset);
+    return offset;
+  }
 
-    // Close file
-    uv_fs_close(nullptr, &req, file, nullptr);
-    uv_fs_req_cleanup(&req);
+  std::string read_text_file_sync(const std::string& path) {
+    size_t size;
+    uv_file file = open_file_for_read(path, size);
+    auto cleanup = on_scope_exit([=]() { close_file_sync(file); });
 
+    std::string str;
+    read_open_file(file, size, [&](size_t length) {
+      str.resize(length);
+      return &str[0];
+    });
     return str;
   }
 
+  void Buffer::resize(size_t new_size) {
+    if (new_size == 0) {
+      free(data);
+      data = nullptr;
+      size = 0;
+      return;
+    }
+    auto* new_data = static_cast<uint8_t*>(std::realloc(data, new_size));
+    if (!new_data) {
+      throw Error {"Out of memory", "ENOMEM"};
+    }
+    data = new_data;
+    size = new_size;
+  }
+
+  void Buffer::free(void* data) {
+    std::free(data);
+  }
+
+  Buffer read_file_sync(const std::string& path) {
+    size_t size;
+    uv_file file = open_file_for_read(path, size);
+    auto cleanup = on_scope_exit([=]() { close_file_sync(file); });
+    // Oversized files are rejected before any memory is allocated
+    Buffer buffer;
+    read_open_file(file, size, [&](size_t length) {
+      if (length > max_read_file_size) {
+        throw Error {"File too large", "EFBIG"};
+      }
+      buffer.resize(length);
+      return reinterpret_cast<char*>(buffer.data);
+    });
+    return buffer;
+  }
+
+  void write_file_sync(
+    const std::string& path,
+    const uint8_t* bytes,
+    size_t length,
+    bool flush)
+  {
+    uv_fs_t req;
+
+    uv_file file = uv_fs_open(
+      nullptr,
+      &req,
+      path.c_str(),
+      UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_TRUNC,
+      0644,
+      nullptr);
+    uv_fs_req_cleanup(&req);
+    _check_uv(file);
+
+    // Errors from closing the file are reported, since a failed close can
+    // mean that written data was lost
+    bool closed = false;
+    auto cleanup = on_scope_exit([&]() {
+      if (!closed) {
+        close_file_sync(file);
+      }
+    });
+
+    size_t offset = 0;
+    while (offset < length) {
+      size_t chunk = std::min(length - offset, max_read_size);
+      uv_buf_t buffer = uv_buf_init(
+        const_cast<char*>(reinterpret_cast<const char*>(bytes + offset)),
+        static_cast<unsigned>(chunk));
+      int written = uv_fs_write(nullptr, &req, file, &buffer, 1, offset, nullptr);
+      uv_fs_req_cleanup(&req);
+      _check_uv(written);
+      offset += written;
+    }
+
+    if (flush) {
+      int result = uv_fs_fsync(nullptr, &req, file, nullptr);
+      uv_fs_req_cleanup(&req);
+      _check_uv(result);
+    }
+
+    closed = true;
+    int result = uv_fs_close(nullptr, &req, file, nullptr);
+    uv_fs_req_cleanup(&req);
+    _check_uv(result);
+  }
+
   template<typename Traits>
   struct FsTask {
     using OnSuccess = typename Traits::OnSuccess;
@@ -212,6 +541,477 @@ namespace os {
     }
   };
 
+  // Runs a blocking operation on the thread pool and reports the result
+  // on the loop thread. Operations with a void result report success
+  // with no value.
+  template<typename Traits>
+  struct WorkTask {
+    using Input = typename Traits::Input;
+    using Result = typename Traits::Result;
+    using OnSuccess = typename Traits::OnSuccess;
+
+    static constexpr bool has_result = !std::is_void_v<Result>;
+
+    uv_work_t req;
+    Input input;
+    std::conditional_t<has_result, Result, bool> result {};
+    Error error {""};
+    bool failed = false;
+    OnSuccess on_success;
+    OnError on_error;
+
+    WorkTask(Input&& input, void* data, OnSuccess on_success, OnError on_error) :
+      input {std::move(input)},
+      on_success {on_success},
+      on_error {on_error}
+    {
+      req.data = data;
+    }
+
+    static void start(Input&& input, void* data, OnSuccess on_success, OnError on_error) {
+      auto* instance = new WorkTask(std::move(input), data, on_success, on_error);
+      int result = uv_queue_work(uv_default_loop(), &instance->req, work, after_work);
+      if (result < 0) {
+        delete instance;
+        enqueue_error_callback(error_from_uv_result(result), data, on_error);
+      }
+    }
+
+    static void work(uv_work_t* req) {
+      static_assert(offsetof(struct WorkTask, req) == 0);
+      auto* instance = reinterpret_cast<WorkTask*>(req);
+      try {
+        if constexpr (has_result) {
+          instance->result = Traits::run(instance->input);
+        } else {
+          Traits::run(instance->input);
+        }
+      } catch (const Error& error) {
+        instance->error = error;
+        instance->failed = true;
+      }
+    }
+
+    static void after_work(uv_work_t* req, int status) {
+      auto* instance = reinterpret_cast<WorkTask*>(req);
+      auto cleanup = on_scope_exit([=]() { delete instance; });
+      if (status < 0) {
+        instance->on_error(error_from_uv_result(status), req->data);
+      } else if (instance->failed) {
+        instance->on_error(instance->error, req->data);
+      } else if constexpr (has_result) {
+        instance->on_success(instance->result, req->data);
+      } else {
+        instance->on_success(req->data);
+      }
+    }
+  };
+
+  void read_text_file(
+    const std::string& path,
+    void* data,
+    OnReadTextFile on_success,
+    OnError on_error)
+  {
+    struct Traits {
+      using Input = std::string;
+      using Result = std::string;
+      using OnSuccess = OnReadTextFile;
+      static std::string run(const std::string& path) {
+        return read_text_file_sync(path);
+      }
+    };
+
+    WorkTask<Traits>::start(std::string {path}, data, on_success, on_error);
+  }
+
+  void read_file(
+    const std::string& path,
+    void* data,
+    OnReadFile on_success,
+    OnError on_error)
+  {
+    struct Traits {
+      using Input = std::string;
+      using Result = Buffer;
+      using OnSuccess = OnReadFile;
+      static Buffer run(const std::string& path) {
+        return read_file_sync(path);
+      }
+    };
+
+    WorkTask<Traits>::start(std::string {path}, data, on_success, on_error);
+  }
+
+  void write_file(
+    const std::string& path,
+    const uint8_t* bytes,
+    size_t length,
+    bool flush,
+    void* data,
+    OnWriteFile on_success,
+    OnError on_error)
+  {
+    struct WriteInput {
+      std::string path;
+      const uint8_t* bytes;
+      size_t length;
+      bool flush;
+    };
+
+    struct Traits {
+      using Input = WriteInput;
+      using Result = void;
+      using OnSuccess = OnWriteFile;
+      static void run(const WriteInput& input) {
+        write_file_sync(input.path, input.bytes, input.length, input.flush);
+      }
+    };
+
+    WorkTask<Traits>::start({path, bytes, length, flush}, data, on_success, on_error);
+  }
+
+  void remove_file(
+    const std::string& path,
+    void* data,
+    OnRemoveFile on_success,
+    OnError on_error)
+  {
+    struct Traits {
+      using OnSuccess = OnRemoveFile;
+      static void map(uv_fs_t*) {}
+    };
+
+    uv_fs_unlink(
+      uv_default_loop(),
+      FsTask<Traits>::create_req(data, on_success, on_error),
+      path.c_str(),
+      FsTask<Traits>::callback);
+  }
+
+  void stat_file(
+    const std::string& path,
+    void* data,
+    OnStatFile on_success,
+    OnError on_error)
+  {
+    struct Traits {
+      using Input = std::string;
+      using Result = std::optional<FileStat>;
+      using OnSuccess = OnStatFile;
+      static std::optional<FileStat> run(const std::string& path) {
+        return stat_file_if_exists_sync(path);
+      }
+    };
+
+    WorkTask<Traits>::start(std::string {path}, data, on_success, on_error);
+  }
+
+  // File streams
+
+  BufferPool::~BufferPool() {
+    for (auto* data : _free) {
+      std::free(data);
+    }
+  }
+
+  uint8_t* BufferPool::acquire() {
+    if (!_free.empty()) {
+      auto* data = _free.back();
+      _free.pop_back();
+      return data;
+    }
+    auto* data = static_cast<uint8_t*>(std::malloc(buffer_size));
+    if (!data) {
+      throw Error {"Out of memory", "ENOMEM"};
+    }
+    return data;
+  }
+
+  void BufferPool::release(uint8_t* data) {
+    if (_free.size() < max_free) {
+      _free.push_back(data);
+    } else {
+      std::free(data);
+    }
+  }
+
+  void PooledBuffer::release(void* buffer) {
+    delete static_cast<PooledBuffer*>(buffer);
+  }
+
+  // Buffers kept for reuse by each stream, beyond the one being read into
+  constexpr size_t stream_pool_size = 4;
+
+  struct FileStream {
+    uv_file file;
+    std::shared_ptr<BufferPool> pool;
+    int64_t position = 0;
+
+    // The read-ahead chunk, while it is being read and after it completes
+    std::unique_ptr<PooledBuffer> chunk;
+    bool reading = false;
+    bool ready = false;
+    bool ended = false;
+    bool failed = false;
+    Error error {""};
+
+    // The pending read request, if any
+    bool waiting = false;
+    void* read_data = nullptr;
+    OnReadFileStream on_read = nullptr;
+    OnError on_read_error = nullptr;
+
+    // The pending close request, if any
+    bool closing = false;
+    bool close_started = false;
+    void* close_data = nullptr;
+    OnCloseFileStream on_close = nullptr;
+    OnError on_close_error = nullptr;
+
+    using OnStep = void (*) (ssize_t result, void* data);
+
+    struct Traits {
+      using OnSuccess = OnStep;
+      static ssize_t map(uv_fs_t* req) { return req->result; }
+    };
+
+    struct CloseTraits {
+      using OnSuccess = OnCloseFileStream;
+      static void map(uv_fs_t*) {}
+    };
+
+    FileStream(uv_file file, size_t chunk_size) :
+      file {file},
+      pool {std::make_shared<BufferPool>(chunk_size, stream_pool_size)}
+    {}
+
+    void read_ahead() {
+      if (reading || ready || ended || failed || closing) {
+        return;
+      }
+
+      try {
+        chunk = std::make_unique<PooledBuffer>(pool);
+      } catch (const Error& e) {
+        failed = true;
+        error = e;
+        return;
+      }
+
+      reading = true;
+      uv_buf_t buffer = uv_buf_init(
+        reinterpret_cast<char*>(chunk->data),
+        static_cast<unsigned>(pool->buffer_size));
+
+      uv_fs_read(
+        uv_default_loop(),
+        FsTask<Traits>::create_req(this, on_read_done, on_read_failed),
+        file,
+        &buffer,
+        1,
+        position,
+        FsTask<Traits>::callback);
+    }
+
+    static void on_read_done(ssize_t bytes, void* data) {
+      auto* stream = static_cast<FileStream*>(data);
+      stream->reading = false;
+      if (bytes == 0) {
+        stream->chunk.reset();
+        stream->ended = true;
+      } else {
+        stream->chunk->size = static_cast<size_t>(bytes);
+        stream->position += bytes;
+        stream->ready = true;
+      }
+      stream->after_read();
+    }
+
+    static void on_read_failed(const Error& error, void* data) {
+      auto* stream = static_cast<FileStream*>(data);
+      stream->reading = false;
+      stream->chunk.reset();
+      stream->failed = true;
+      stream->error = error;
+      stream->after_read();
+    }
+
+    void after_read() {
+      deliver();
+      if (closing && !reading) {
+        close();
+      }
+    }
+
+    // Completes the pending read request if a result is available, and
+    // starts reading the following chunk
+    void deliver() {
+      if (!waiting) {
+        return;
+      }
+
+      if (!ready && !failed && !ended) {
+        read_ahead();
+      }
+
+      if (ready) {
+        ready = false;
+        waiting = false;
+        auto result = std::move(chunk);
+        read_ahead();
+        on_read(result, read_data);
+      } else if (failed) {
+        waiting = false;
+        on_read_error(error, read_data);
+      } else if (ended) {
+        waiting = false;
+        std::unique_ptr<PooledBuffer> result;
+        on_read(result, read_data);
+      }
+    }
+
+    void close() {
+      // A reader may close the stream from its read callback
+      if (close_started) {
+        return;
+      }
+      close_started = true;
+      chunk.reset();
+      uv_fs_close(
+        uv_default_loop(),
+        FsTask<CloseTraits>::create_req(this, on_closed, on_close_failed),
+        file,
+        FsTask<CloseTraits>::callback);
+    }
+
+    static void on_closed(void* data) {
+      auto* stream = static_cast<FileStream*>(data);
+      auto cleanup = on_scope_exit([=]() { delete stream; });
+      stream->on_close(stream->close_data);
+    }
+
+    static void on_close_failed(const Error& error, void* data) {
+      auto* stream = static_cast<FileStream*>(data);
+      auto cleanup = on_scope_exit([=]() { delete stream; });
+      stream->on_close_error(error, stream->close_data);
+    }
+  };
+
+  std::unordered_set<FileStreamHandle> file_stream_handles;
+
+  void open_file_stream(
+    const std::string& path,
+    size_t chunk_size,
+    void* data,
+    OnOpenFileStream on_success,
+    OnError on_error)
+  {
+    if (chunk_size == 0 || chunk_size > max_read_size) {
+      return enqueue_error_callback(
+        Error {"Invalid chunk size", "EINVAL"},
+        data,
+        on_error);
+    }
+
+    struct Open {
+      size_t chunk_size;
+      void* data;
+      OnOpenFileStream on_success;
+      OnError on_error;
+
+      struct Traits {
+        using OnSuccess = FileStream::OnStep;
+        static ssize_t map(uv_fs_t* req) { return req->result; }
+      };
+
+      static void on_opened(ssize_t file, void* data) {
+        auto* open = static_cast<Open*>(data);
+        auto cleanup = on_scope_exit([=]() { delete open; });
+        auto* stream = new FileStream(static_cast<uv_file>(file), open->chunk_size);
+        auto handle = reinterpret_cast<FileStreamHandle>(stream);
+        file_stream_handles.insert(handle);
+        // The first chunk is read before it is requested
+        stream->read_ahead();
+        open->on_success(handle, open->data);
+      }
+
+      static void on_failed(const Error& error, void* data) {
+        auto* open = static_cast<Open*>(data);
+        auto cleanup = on_scope_exit([=]() { delete open; });
+        open->on_error(error, open->data);
+      }
+    };
+
+    auto* open = new Open {chunk_size, data, on_success, on_error};
+    uv_fs_open(
+      uv_default_loop(),
+      FsTask<Open::Traits>::create_req(open, Open::on_opened, Open::on_failed),
+      path.c_str(),
+      UV_FS_O_RDONLY,
+      0,
+      FsTask<Open::Traits>::callback);
+  }
+
+  void read_file_stream(
+    FileStreamHandle handle,
+    void* data,
+    OnReadFileStream on_success,
+    OnError on_error)
+  {
+    if (file_stream_handles.count(handle) == 0) {
+      return enqueue_error_callback(
+        Error {"not an open file stream"},
+        data,
+        on_error);
+    }
+
+    auto* stream = reinterpret_cast<FileStream*>(handle);
+    if (stream->waiting) {
+      return enqueue_error_callback(
+        Error {"read_file_stream in progress"},
+        data,
+        on_error);
+    }
+
+    stream->waiting = true;
+    stream->read_data = data;
+    stream->on_read = on_success;
+    stream->on_read_error = on_error;
+    stream->deliver();
+  }
+
+  bool close_file_stream(
+    FileStreamHandle handle,
+    void* data,
+    OnCloseFileStream on_success,
+    OnError on_error)
+  {
+    auto iter = file_stream_handles.find(handle);
+    if (iter == file_stream_handles.end()) {
+      enqueue_error_callback(
+        Error {"not an open file stream"},
+        data,
+        on_error);
+      return false;
+    }
+
+    auto* stream = reinterpret_cast<FileStream*>(handle);
+    file_stream_handles.erase(iter);
+
+    stream->closing = true;
+    stream->close_data = data;
+    stream->on_close = on_success;
+    stream->on_close_error = on_error;
+
+    // A read that is in flight, whether requested or read ahead, is
+    // completed before the file is closed
+    if (!stream->reading) {
+      stream->close();
+    }
+    return true;
+  }
+
   // Directory access
 
   std::unordered_set<DirectoryHandle> directory_handles;
@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <map>
+#include <memory>
+#include <optional>
 
 #include "common.h"
 
@@ -9,6 +11,7 @@ namespace os {
 
   using FileHandle = uintptr_t;
   using DirectoryHandle = uintptr_t;
+  using FileStreamHandle = uintptr_t;
   using TimerHandle = uintptr_t;
 
   struct Error {
@@ -29,16 +32,294 @@ namespace os {
   // Returns the current working directory
   std::string cwd();
 
+  // Returns the directory for temporary files
+  std::string temp_directory();
+
   // Synchronously reads a text file into a string
   std::string read_text_file_sync(const std::string& path);
 
+  // A heap-allocated byte buffer. Ownership of the memory can be released
+  // to another owner, which must free it with `Buffer::free`.
+  struct Buffer {
+    uint8_t* data = nullptr;
+    size_t size = 0;
+
+    Buffer() = default;
+    Buffer(const Buffer& other) = delete;
+    Buffer& operator=(const Buffer& other) = delete;
+
+    Buffer(Buffer&& other) : data {other.data}, size {other.size} {
+      other.data = nullptr;
+      other.size = 0;
+    }
+
+    Buffer& operator=(Buffer&& other) {
+      if (this != &other) {
+        free(data);
+        data = other.data;
+        size = other.size;
+        other.data = nullptr;
+        other.size = 0;
+      }
+      return *this;
+    }
+
+    ~Buffer() {
+      free(data);
+    }
+
+    uint8_t* release() {
+      auto* result = data;
+      data = nullptr;
+      size = 0;
+      return result;
+    }
+
+    // Changes the size of the buffer, keeping its contents
+    void resize(size_t new_size);
+
+    static void free(void* data);
+  };
+
+  // Fixed-size buffers that are reused instead of freed. Up to `max_free`
+  // buffers are kept for reuse.
+  struct BufferPool {
+    size_t buffer_size;
+    size_t max_free;
+    std::vector<uint8_t*> _free;
+
+    BufferPool(size_t buffer_size, size_t max_free) :
+      buffer_size {buffer_size},
+      max_free {max_free}
+    {}
+
+    BufferPool(const BufferPool& other) = delete;
+    BufferPool& operator=(const BufferPool& other) = delete;
+
+    ~BufferPool();
+
+    uint8_t* acquire();
+    void release(uint8_t* data);
+  };
+
+  // A buffer from a pool, which is returned to the pool when the object is
+  // deleted. The pool is kept alive by its outstanding buffers.
+  struct PooledBuffer {
+    std::shared_ptr<BufferPool> pool;
+    uint8_t* data;
+    size_t size = 0;
+
+    explicit PooledBuffer(std::shared_ptr<BufferPool> pool) :
+      pool {std::move(pool)},
+      data {this->pool->acquire()}
+    {}
+
+    PooledBuffer(const PooledBuffer& other) = delete;
+    PooledBuffer& operator=(const PooledBuffer& other) = delete;
+
+    ~PooledBuffer() {
+      pool->release(data);
+    }
+
+    // Deletes a pooled buffer, given as a void pointer
+    static void release(void* buffer);
+  };
+
+  struct FileStat {
+    uint64_t size = 0;
+    uint64_t modified_time_ns = 0;
+  };
+
+  // Synchronously reads the size and modification time of a file
+  FileStat stat_file_sync(const std::string& path);
+
+  // A memory mapping of a file. The mapping is released when the object
+  // is destroyed.
+  struct MappedFile {
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    // The distance from the start of the mapped pages to `data`
+    size_t _page_offset = 0;
+#ifdef _WIN32
+    void* _mapping = nullptr;
+#endif
+
+    MappedFile() = default;
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+
+    MappedFile(MappedFile&& other) {
+      *this = std::move(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other);
+
+    ~MappedFile() {
+      unmap();
+    }
+
+    void unmap();
+  };
+
+  enum class MapAccess {
+    // The mapped memory must not be written
+    read,
+    // Writes to the mapped memory are private to the mapping
+    copy_on_write,
+    // Writes to the mapped memory are written to the file
+    write,
+  };
+
+  // Synchronously maps a file into memory
+  MappedFile map_file(const std::string& path, MapAccess access = MapAccess::read);
+
+  // Synchronously maps part of a file into memory, starting at `offset`.
+  // If `length` is empty, the rest of the file is mapped. Throws EINVAL if
+  // the range extends past the end of the file, and EFBIG if its length
+  // is greater than `max_length`.
+  MappedFile map_file(
+    const std::string& path,
+    MapAccess access,
+    uint64_t offset,
+    std::optional<uint64_t> length,
+    uint64_t max_length);
+
   using OnError = void (*) (const Error& error, void* data);
+  using OnReadTextFile = void (*) (std::string& content, void* data);
+  using OnReadFile = void (*) (Buffer& buffer, void* data);
+  using OnWriteFile = void (*) (void* data);
+  using OnRemoveFile = void (*) (void* data);
+  using OnStatFile = void (*) (std::optional<FileStat>& stat, void* data);
   using OnOpenDirectory = void (*) (DirectoryHandle handle, void* data);
+  using OnOpenFileStream = void (*) (FileStreamHandle handle, void* data);
+  using OnReadFileStream = void (*) (std::unique_ptr<PooledBuffer>& chunk, void* data);
+  using OnCloseFileStream = void (*) (void* data);
   using OnReadDirectory = void (*) (std::vector<std::string>& entries, void* data);
   using OnCloseDirectory = void (*) (void* data);
   using OnProcessExit = void (*) (int64_t status, int signal, void* data);
   using OnTimer = void (*) (void* data);
 
+  // Reads a text file into a string on the thread pool
+  void read_text_file(
+    const std::string& path,
+    void* data,
+    OnReadTextFile on_success,
+    OnError on_error);
+
+  template<typename T>
+  void read_text_file(const std::string& path, void* data) {
+    return read_text_file(path, data, T::on_success, T::on_error);
+  }
+
+  // The following operations each run as a single job on the thread pool,
+  // rather than as a sequence of libuv requests on the loop thread
+
+  // The largest file that `read_file` reads. The limit matches the largest
+  // length of an ArrayBuffer.
+  inline constexpr size_t max_read_file_size = UINT32_MAX;
+
+  // Reads a file into a buffer. Files larger than `max_read_file_size`
+  // fail with EFBIG.
+  void read_file(
+    const std::string& path,
+    void* data,
+    OnReadFile on_success,
+    OnError on_error);
+
+  template<typename T>
+  void read_file(const std::string& path, void* data) {
+    return read_file(path, data, T::on_success, T::on_error);
+  }
+
+  // Writes bytes to a file, replacing its contents. If `flush` is true,
+  // the contents are flushed to storage before the callback is called.
+  // The bytes must remain valid until a callback is called.
+  void write_file(
+    const std::string& path,
+    const uint8_t* bytes,
+    size_t length,
+    bool flush,
+    void* data,
+    OnWriteFile on_success,
+    OnError on_error);
+
+  template<typename T>
+  void write_file(
+    const std::string& path,
+    const uint8_t* bytes,
+    size_t length,
+    bool flush,
+    void* data)
+  {
+    return write_file(path, bytes, length, flush, data, T::on_success, T::on_error);
+  }
+
+  // Removes a file
+  void remove_file(
+    const std::string& path,
+    void* data,
+    OnRemoveFile on_success,
+    OnError on_error);
+
+  template<typename T>
+  void remove_file(const std::string& path, void* data) {
+    return remove_file(path, data, T::on_success, T::on_error);
+  }
+
+  // Reads the size and modification time of a file. The result is empty
+  // if the file does not exist.
+  void stat_file(
+    const std::string& path,
+    void* data,
+    OnStatFile on_success,
+    OnError on_error);
+
+  template<typename T>
+  void stat_file(const std::string& path, void* data) {
+    return stat_file(path, data, T::on_success, T::on_error);
+  }
+
+  // Opens a file for reading in chunks of up to `chunk_size` bytes. One
+  // read is kept in flight ahead of the reader. Reading pauses when a
+  // chunk is ready and has not been requested.
+  void open_file_stream(
+    const std::string& path,
+    size_t chunk_size,
+    void* data,
+    OnOpenFileStream on_success,
+    OnError on_error);
+
+  template<typename T>
+  void open_file_stream(const std::string& path, size_t chunk_size, void* data) {
+    return open_file_stream(path, chunk_size, data, T::on_success, T::on_error);
+  }
+
+  // Reads the next chunk from a file stream. The chunk is empty at the end
+  // of the file.
+  void read_file_stream(
+    FileStreamHandle handle,
+    void* data,
+    OnReadFileStream on_success,
+    OnError on_error);
+
+  template<typename T>
+  void read_file_stream(FileStreamHandle handle, void* data) {
+    return read_file_stream(handle, data, T::on_success, T::on_error);
+  }
+
+  // Closes a file stream, after any read that is in progress completes.
+  // Returns false, and reports an error, if the stream is not open.
+  bool close_file_stream(
+    FileStreamHandle handle,
+    void* data,
+    OnCloseFileStream on_success,
+    OnError on_error);
+
+  template<typename T>
+  bool close_file_stream(FileStreamHandle handle, void* data) {
+    return close_file_stream(handle, data, T::on_success, T::on_error);
+  }
+
   // Starts a timer
   TimerHandle start_timer(
     uint64_t timeout,
@@ -0,0 +1,75 @@
+// Build tool: serializes the bootstrap script to ChakraCore bytecode and
+// writes it out as a header, so that startup does not need to parse it.
+
+#include <fstream>
+#include <iomanip>
+
+#include "common.h"
+#include "main.js.h"
+
+int fail(const char* message, JsErrorCode code = JsNoError) {
+  std::cerr << "serialize_main: " << message;
+  if (code != JsNoError) {
+    std::cerr << " (error " << static_cast<int>(code) << ")";
+  }
+  std::cerr << "\n";
+  return 1;
+}
+
+int main(int arg_count, char** args) {
+  if (arg_count < 2) {
+    return fail("usage: serialize_main output-file");
+  }
+
+  // The runtime attributes must match those used by js::Engine
+  JsRuntimeHandle runtime;
+  if (auto code = JsCreateRuntime(JsRuntimeAttributeNone, nullptr, &runtime)) {
+    return fail("unable to create runtime", code);
+  }
+
+  auto cleanup = on_scope_exit([&]() {
+    JsSetCurrentContext(nullptr);
+    JsDisposeRuntime(runtime);
+  });
+
+  JsContextRef context;
+  if (auto code = JsCreateContext(runtime, &context)) {
+    return fail("unable to create context", code);
+  }
+
+  if (auto code = JsSetCurrentContext(context)) {
+    return fail("unable to set current context", code);
+  }
+
+  JsValueRef source;
+  if (auto code = JsCreateString(main_js.data(), main_js.length(), &source)) {
+    return fail("unable to create source string", code);
+  }
+
+  JsValueRef buffer;
+  if (auto code = JsSerialize(source, &buffer, JsParseScriptAttributeNone)) {
+    return fail("unable to serialize main.js", code);
+  }
+
+  uint8_t* data;
+  unsigned length;
+  if (auto code = JsGetArrayBufferStorage(buffer, &data, &length)) {
+    return fail("unable to read serialized bytecode", code);
+  }
+
+  std::ofstream out {args[1], std::ios::binary};
+  if (!out) {
+    return fail("unable to open output file");
+  }
+
+  out << "// AUTOGENERATED\n";
+  out << "static const uint8_t main_js_bytecode[] = {";
+  out << std::hex << std::setfill('0');
+  for (unsigned i = 0; i < length; ++i) {
+    out << (i % 16 == 0 ? "\n  " : " ");
+    out << "0x" << std::setw(2) << static_cast<unsigned>(data[i]) << ",";
+  }
+  out << "\n};\n";
+
+  return out ? 0 : fail("unable to write output file");
+}
@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include "common.h"
 #include "os.h"
 #include "url.h"
@@ -11,10 +13,11 @@ namespace {
   using js::RealmAPI;
   using js::CallArgs;
   using js::NativeFunc;
+  using js::TypedNativeFunc;
 
   Var os_error_to_js_error(RealmAPI& api, const os::Error& error) {
     auto e = api.create_error(error.message);
-    api.set_property(e, "code", api.create_string(error.code));
+    api.set_property<js::names::code>(e, api.create_string(error.code));
     return e;
   }
 
@@ -23,20 +26,12 @@ namespace {
   }
 
   Var track_callback_arg(Var arg) {
-    // TODO: Throw if not callable?
     VarRef::increment(arg);
     return arg;
   }
 
   void enqueue_error_callback(RealmAPI& api, Var callback, Var error) {
-    api.enqueue_job(callback, {api.undefined(), error});
-  }
-
-  void enqueue_type_error(RealmAPI& api, Var callback, const std::string& message) {
-    api.enqueue_job(callback, {
-      api.undefined(),
-      api.create_type_error(message),
-    });
+    api.enqueue_job(callback, {api.undefined(), error}, js::JobLane::host);
   }
 
   std::string url_to_file_path(const std::string& url) {
@@ -73,22 +68,43 @@ namespace {
     }
   };
 
+  struct ObjectBuilder {
+    RealmAPI& _api;
+    Var _object;
+
+    ObjectBuilder(RealmAPI& api) : _api {api} {
+      _object = _api.create_object();
+    }
+
+    ObjectBuilder(RealmAPI& api, Var object) : _api {api}, _object {object} {}
+
+    Var object() { return _object; }
+
+    template<typename T>
+    void add_method() {
+      auto fn = _api.create_function<T>();
+      _api.set_property(_object, T::name, fn);
+    }
+
+    void add_property(const std::string& name, Var value) {
+      _api.set_property(_object, name, value);
+    }
+  };
+
   struct StdOutFunc : public NativeFunc {
     inline static std::string name = "stdout";
     static Var call(RealmAPI& api, CallArgs& args) {
       // TODO: Handle buffer types
       for (unsigned i = 1; i < args.count; ++i) {
-        std::cout << api.utf8_string(args[i]);
+        std::cout << api.utf8_view(args[i]);
       }
       return api.undefined();
     }
   };
 
-  struct ResolveURLFunc : public NativeFunc {
+  struct ResolveURLFunc : public TypedNativeFunc<ResolveURLFunc> {
     inline static std::string name = "resolveURL";
-    static Var call(RealmAPI& api, CallArgs& args) {
-      auto url = api.utf8_string(args[1]);
-      auto base = api.utf8_string(args[2]);
+    static Var invoke(RealmAPI& api, const std::string& url, const std::string& base) {
       // TODO: throw if URL parsing fails
       auto base_url = URLInfo::parse(base);
       auto info = URLInfo::parse(url, &base_url);
@@ -96,11 +112,9 @@ namespace {
     }
   };
 
-  struct ResolveFilePathFunc : public NativeFunc {
+  struct ResolveFilePathFunc : public TypedNativeFunc<ResolveFilePathFunc> {
     inline static std::string name = "resolveFilePath";
-    static Var call(RealmAPI& api, CallArgs& args) {
-      auto path = api.utf8_string(args[1]);
-      auto base = api.utf8_string(args[2]);
+    static Var invoke(RealmAPI& api, const std::string& path, const std::string& base) {
       // TODO: throw if URL parsing fails
       auto base_url = URLInfo::parse(base);
       auto info = URLInfo::from_file_path(path, &base_url);
@@ -108,10 +122,9 @@ namespace {
     }
   };
 
-  struct ReadTextFileSyncFunc : public NativeFunc {
+  struct ReadTextFileSyncFunc : public TypedNativeFunc<ReadTextFileSyncFunc> {
     inline static std::string name = "readTextFileSync";
-    static Var call(RealmAPI& api, CallArgs& args) {
-      auto url_string = api.utf8_string(args[1]);
+    static Var invoke(RealmAPI& api, const std::string& url_string) {
       auto path = url_to_file_path(url_string);
       try {
         auto content = os::read_text_file_sync(path);
@@ -123,17 +136,209 @@ namespace {
     }
   };
 
-  struct CwdFunc : public NativeFunc {
+  struct ReadTextFileFunc : public TypedNativeFunc<ReadTextFileFunc> {
+    inline static std::string name = "readTextFile";
+
+    struct Callback : public OsCallback {
+      static void on_success(std::string& content, void* data) {
+        dispatch_os_result(data, [&](auto& api) {
+          return api.create_string(content);
+        });
+      }
+    };
+
+    static void invoke(RealmAPI& api, const std::string& url_string, js::Callback callback) {
+      auto path = url_to_file_path(url_string);
+      os::read_text_file<Callback>(path, track_callback_arg(callback));
+    }
+  };
+
+  struct ReadFileFunc : public TypedNativeFunc<ReadFileFunc> {
+    inline static std::string name = "readFile";
+
+    struct Callback : public OsCallback {
+      static void on_success(os::Buffer& buffer, void* data) {
+        dispatch_os_result(data, [&](auto& api) {
+          // The buffer's memory is handed to the ArrayBuffer without
+          // copying and freed when the ArrayBuffer is collected
+          size_t size = buffer.size;
+          auto* bytes = buffer.release();
+          return api.create_external_array_buffer(bytes, size, os::Buffer::free, bytes);
+        });
+      }
+    };
+
+    static void invoke(RealmAPI& api, const std::string& url_string, js::Callback callback) {
+      auto path = url_to_file_path(url_string);
+      os::read_file<Callback>(path, track_callback_arg(callback));
+    }
+  };
+
+  struct WriteFileFunc : public TypedNativeFunc<WriteFileFunc> {
+    inline static std::string name = "writeFile";
+
+    struct Request {
+      Var callback;
+      // Keeps a buffer argument alive while its memory is written
+      VarRef source;
+      std::string text;
+    };
+
+    struct Callback {
+      static void on_success(void* data) {
+        auto* request = reinterpret_cast<Request*>(data);
+        auto callback = request->callback;
+        delete request;
+        OsCallback::on_success(callback);
+      }
+
+      static void on_error(const os::Error& error, void* data) {
+        auto* request = reinterpret_cast<Request*>(data);
+        auto callback = request->callback;
+        delete request;
+        OsCallback::on_error(error, callback);
+      }
+    };
+
+    static void invoke(
+      RealmAPI& api,
+      const std::string& url_string,
+      Var data,
+      bool flush,
+      js::Callback callback)
+    {
+      auto path = url_to_file_path(url_string);
+      auto request = std::make_unique<Request>();
+
+      // Buffer contents are written in place. Strings are written as UTF-8.
+      uint8_t* bytes = nullptr;
+      size_t length = 0;
+      if (api.value_type(data) == JsString) {
+        request->text = api.utf8_string(data);
+        bytes = reinterpret_cast<uint8_t*>(request->text.data());
+        length = request->text.size();
+      } else if (api.get_buffer_storage(data, bytes, length)) {
+        request->source = VarRef {data};
+      } else {
+        js::throw_argument_error(api, 2, "a string or buffer");
+      }
+
+      request->callback = track_callback_arg(callback);
+      os::write_file<Callback>(path, bytes, length, flush, request.release());
+    }
+  };
+
+  struct StatFileFunc : public TypedNativeFunc<StatFileFunc> {
+    inline static std::string name = "statFile";
+
+    struct Callback : public OsCallback {
+      static void on_success(std::optional<os::FileStat>& stat, void* data) {
+        dispatch_os_result(data, [&](auto& api) {
+          if (!stat) {
+            return api.null_value();
+          }
+          // Modification times are reported in milliseconds, like Date
+          ObjectBuilder builder {api};
+          builder.add_property("size", api.create_number(static_cast<double>(stat->size)));
+          builder.add_property("modifiedTime", api.create_number(stat->modified_time_ns / 1e6));
+          return builder.object();
+        });
+      }
+    };
+
+    static void invoke(RealmAPI& api, const std::string& url_string, js::Callback callback) {
+      auto path = url_to_file_path(url_string);
+      os::stat_file<Callback>(path, track_callback_arg(callback));
+    }
+  };
+
+  struct RemoveFileFunc : public TypedNativeFunc<RemoveFileFunc> {
+    inline static std::string name = "removeFile";
+
+    static void invoke(RealmAPI& api, const std::string& url_string, js::Callback callback) {
+      auto path = url_to_file_path(url_string);
+      os::remove_file<OsCallback>(path, track_callback_arg(callback));
+    }
+  };
+
+  struct MapFileFunc : public TypedNativeFunc<MapFileFunc> {
+    inline static std::string name = "mapFile";
+
+    // Unmaps the file when the ArrayBuffer is collected
+    static void CHAKRA_CALLBACK finalize_callback(void* data) {
+      delete reinterpret_cast<os::MappedFile*>(data);
+    }
+
+    static Var invoke(RealmAPI& api, const std::string& url_string, Var options) {
+      auto path = url_to_file_path(url_string);
+
+      // Writes to a mapping that is not writable stay in memory, so that
+      // scripts cannot fault on read-only pages
+      bool writable = false;
+      uint64_t offset = 0;
+      std::optional<uint64_t> length;
+      if (!api.is_null_or_undefined(options)) {
+        Var value = api.get_property<js::names::writable>(options);
+        if (!api.is_null_or_undefined(value)) {
+          writable = js::ArgConverter<bool>::convert(api, value, 2);
+        }
+        value = api.get_property<js::names::offset>(options);
+        if (!api.is_null_or_undefined(value)) {
+          offset = js::ArgConverter<uint64_t>::convert(api, value, 2);
+        }
+        value = api.get_property<js::names::length>(options);
+        if (!api.is_null_or_undefined(value)) {
+          length = js::ArgConverter<uint32_t>::convert(api, value, 2);
+        }
+      }
+
+      // Files that do not fit in an ArrayBuffer are rejected before they
+      // are mapped, and can be mapped in windows with `offset` and `length`
+      std::unique_ptr<os::MappedFile> mapped;
+      try {
+        auto access = writable ? os::MapAccess::write : os::MapAccess::copy_on_write;
+        mapped = std::make_unique<os::MappedFile>(os::map_file(
+          path,
+          access,
+          offset,
+          length,
+          std::numeric_limits<unsigned>::max()));
+      } catch (const os::Error& error) {
+        throw_os_error(api, error);
+        return nullptr;
+      }
+
+      auto* bytes = mapped->data;
+      size_t size = mapped->size;
+      return api.create_external_array_buffer(bytes, size, finalize_callback, mapped.release());
+    }
+  };
+
+  struct CwdFunc : public TypedNativeFunc<CwdFunc> {
     inline static std::string name = "cwd";
-    static Var call(RealmAPI& api, CallArgs& args) {
+    static Var invoke(RealmAPI& api) {
       auto url_info = URLInfo::from_file_path(os::cwd() + "/");
       return api.create_string(URLInfo::stringify(url_info));
     }
   };
 
+  struct TempDirectoryFunc : public TypedNativeFunc<TempDirectoryFunc> {
+    inline static std::string name = "tempDirectory";
+    static Var invoke(RealmAPI& api) {
+      try {
+        auto url_info = URLInfo::from_file_path(os::temp_directory() + "/");
+        return api.create_string(URLInfo::stringify(url_info));
+      } catch (const os::Error& error) {
+        throw_os_error(api, error);
+        return nullptr;
+      }
+    }
+  };
+
   enum class HostObjectKind : unsigned {
     timer_handle,
     directory_handle,
+    file_stream_handle,
   };
 
   template<HostObjectKind kind_value>
@@ -148,13 +353,15 @@ namespace {
     os::TimerHandle handle;
     VarRef callback;
 
+    inline static const char* description = "timer object";
+
     explicit TimerObjectInfo(os::TimerHandle handle, Var callback) :
       handle {handle},
       callback {callback}
     {}
   };
 
-  struct StartTimerFunc : public NativeFunc {
+  struct StartTimerFunc : public TypedNativeFunc<StartTimerFunc> {
     inline static std::string name = "startTimer";
 
     static void timer_callback(void* data) {
@@ -162,27 +369,22 @@ namespace {
       event_loop::dispatch_event(callback);
     }
 
-    static Var call(RealmAPI& api, CallArgs& args) {
-      auto timeout = api.to_integer<uint64_t>(args[1]);
-      auto repeat = api.to_integer<uint64_t>(args[2]);
-      auto callback = args[3];
+    static Var invoke(
+      RealmAPI& api,
+      uint64_t timeout,
+      uint64_t repeat,
+      js::Callback callback)
+    {
       auto handle = os::start_timer(timeout, repeat, callback, timer_callback);
       return api.create_host_object<TimerObjectInfo>(handle, callback);
     }
   };
 
-  struct StopTimerFunc : public NativeFunc {
+  struct StopTimerFunc : public TypedNativeFunc<StopTimerFunc> {
     inline static std::string name = "stopTimer";
 
-    static Var call(RealmAPI& api, CallArgs& args) {
-      auto* dir = api.get_host_object_data<TimerObjectInfo>(args[1]);
-      if (!dir) {
-        auto err = api.create_type_error("Not a valid timer object");
-        api.throw_exception(err);
-        return nullptr;
-      }
-      os::stop_timer(dir->handle);
-      return nullptr;
+    static void invoke(RealmAPI& api, TimerObjectInfo* timer) {
+      os::stop_timer(timer->handle);
     }
   };
 
@@ -191,6 +393,8 @@ namespace {
   {
     os::DirectoryHandle handle;
 
+    inline static const char* description = "directory object";
+
     explicit DirectoryObjectInfo(os::DirectoryHandle handle) :
       handle {handle}
     {}
@@ -200,7 +404,7 @@ namespace {
     }
   };
 
-  struct OpenDirectoryFunc : public NativeFunc {
+  struct OpenDirectoryFunc : public TypedNativeFunc<OpenDirectoryFunc> {
     inline static std::string name = "openDirectory";
 
     struct Callback : public OsCallback {
@@ -211,60 +415,208 @@ namespace {
       }
     };
 
-    static Var call(RealmAPI& api, CallArgs& args) {
-      auto url_string = api.utf8_string(args[1]);
+    static void invoke(RealmAPI& api, const std::string& url_string, js::Callback callback) {
       auto path = url_to_file_path(url_string);
-      auto callback = track_callback_arg(args[2]);
-      os::open_directory<Callback>(path, callback);
-      return nullptr;
+      os::open_directory<Callback>(path, track_callback_arg(callback));
     }
   };
 
-  struct ReadDirectoryFunc : public NativeFunc {
+  struct ReadDirectoryFunc : public TypedNativeFunc<ReadDirectoryFunc> {
     inline static std::string name = "readDirectory";
 
     struct Callback : public OsCallback {
       static void on_success(std::vector<std::string>& entries, void* data) {
         dispatch_os_result(data, [&](auto& api) {
-          Var array = api.create_array(static_cast<int>(entries.size()));
-          for (int i = 0; i < entries.size(); ++i) {
-            auto entry = api.create_string(entries[i]);
-            api.set_indexed_property(array, i, entry);
+          return api.create_array(entries, [&](auto& entry) {
+            return api.create_string(entry);
+          });
+        });
+      }
+    };
+
+    static void invoke(
+      RealmAPI& api,
+      DirectoryObjectInfo* dir,
+      size_t count,
+      js::Callback callback)
+    {
+      os::read_directory<Callback>(dir->handle, count, track_callback_arg(callback));
+    }
+  };
+
+  struct CloseDirectoryFunc : public TypedNativeFunc<CloseDirectoryFunc> {
+    inline static std::string name = "closeDirectory";
+
+    static void invoke(RealmAPI& api, DirectoryObjectInfo* dir, js::Callback callback) {
+      os::close_directory<OsCallback>(dir->handle, track_callback_arg(callback));
+    }
+  };
+
+  struct FileStreamObjectInfo :
+    public HostObjectInfo<HostObjectKind::file_stream_handle>
+  {
+    // Cleared when the stream is closed
+    os::FileStreamHandle handle;
+    size_t chunk_size;
+
+    inline static const char* description = "file stream object";
+
+    explicit FileStreamObjectInfo(os::FileStreamHandle handle, size_t chunk_size) :
+      handle {handle},
+      chunk_size {chunk_size}
+    {}
+
+    struct IgnoreResult {
+      static void on_success(void* data) {}
+      static void on_error(const os::Error& error, void* data) {}
+    };
+
+    ~FileStreamObjectInfo() {
+      // Streams that were not closed by the program are closed when
+      // collected
+      if (handle) {
+        os::close_file_stream<IgnoreResult>(handle, nullptr);
+      }
+    }
+  };
+
+  struct OpenFileStreamFunc : public TypedNativeFunc<OpenFileStreamFunc> {
+    inline static std::string name = "openFileStream";
+
+    static constexpr size_t default_chunk_size = 64 * 1024;
+
+    struct Request {
+      Var callback;
+      size_t chunk_size;
+    };
+
+    struct Callback {
+      static void on_success(os::FileStreamHandle stream, void* data) {
+        auto* request = reinterpret_cast<Request*>(data);
+        auto cleanup = on_scope_exit([=]() { delete request; });
+        dispatch_os_result(request->callback, [&](auto& api) {
+          return api.create_host_object<FileStreamObjectInfo>(stream, request->chunk_size);
+        });
+      }
+
+      static void on_error(const os::Error& error, void* data) {
+        auto* request = reinterpret_cast<Request*>(data);
+        auto callback = request->callback;
+        delete request;
+        OsCallback::on_error(error, callback);
+      }
+    };
+
+    static void invoke(
+      RealmAPI& api,
+      const std::string& url_string,
+      js::Object options,
+      js::Callback callback)
+    {
+      auto path = url_to_file_path(url_string);
+
+      size_t chunk_size = default_chunk_size;
+      Var chunk_size_var = api.get_property<js::names::chunk_size>(options);
+      if (!api.is_null_or_undefined(chunk_size_var)) {
+        chunk_size = js::ArgConverter<uint32_t>::convert(api, chunk_size_var, 2);
+      }
+
+      auto* request = new Request {track_callback_arg(callback), chunk_size};
+      os::open_file_stream<Callback>(path, chunk_size, request);
+    }
+  };
+
+  struct ReadFileStreamFunc : public TypedNativeFunc<ReadFileStreamFunc> {
+    inline static std::string name = "readFileStream";
+
+    // Chunks are returned as ArrayBuffers that use the stream's pooled
+    // memory, which is reused after the ArrayBuffer is collected
+    struct ChunkCallback : public OsCallback {
+      static void on_success(std::unique_ptr<os::PooledBuffer>& chunk, void* data) {
+        dispatch_os_result(data, [&](auto& api) {
+          if (!chunk) {
+            return api.null_value();
           }
-          return array;
+          auto* bytes = chunk->data;
+          size_t size = chunk->size;
+          return api.create_external_array_buffer(
+            bytes,
+            size,
+            os::PooledBuffer::release,
+            chunk.release());
         });
       }
     };
 
-    static Var call(RealmAPI& api, CallArgs& args) {
-      auto* dir = api.get_host_object_data<DirectoryObjectInfo>(args[1]);
-      if (!dir) {
-        enqueue_type_error(api, args[3], "Not a valid directory object");
-        return nullptr;
+    // Chunks are copied into a buffer provided by the caller, and their
+    // memory is returned to the pool immediately
+    struct CopyRequest {
+      Var callback;
+      VarRef destination;
+      uint8_t* bytes;
+    };
+
+    struct CopyCallback {
+      static void on_success(std::unique_ptr<os::PooledBuffer>& chunk, void* data) {
+        auto* request = reinterpret_cast<CopyRequest*>(data);
+        auto cleanup = on_scope_exit([=]() { delete request; });
+        size_t size = 0;
+        if (chunk) {
+          size = chunk->size;
+          std::memcpy(request->bytes, chunk->data, size);
+          chunk.reset();
+        }
+        dispatch_os_result(request->callback, [&](auto& api) {
+          return size > 0 ? api.create_number(static_cast<double>(size)) : api.null_value();
+        });
       }
-      auto count = api.to_integer<size_t>(args[2]);
-      auto callback = track_callback_arg(args[3]);
-      os::read_directory<Callback>(dir->handle, count, callback);
-      return nullptr;
+
+      static void on_error(const os::Error& error, void* data) {
+        auto* request = reinterpret_cast<CopyRequest*>(data);
+        auto callback = request->callback;
+        delete request;
+        OsCallback::on_error(error, callback);
+      }
+    };
+
+    static void invoke(
+      RealmAPI& api,
+      FileStreamObjectInfo* stream,
+      Var destination,
+      js::Callback callback)
+    {
+      if (api.is_null_or_undefined(destination)) {
+        os::read_file_stream<ChunkCallback>(stream->handle, track_callback_arg(callback));
+        return;
+      }
+
+      uint8_t* bytes = nullptr;
+      size_t length = 0;
+      if (!api.get_buffer_storage(destination, bytes, length)) {
+        js::throw_argument_error(api, 2, "a buffer");
+      }
+      if (length < stream->chunk_size) {
+        js::throw_argument_error(api, 2, "at least as large as the chunk size");
+      }
+
+      auto* request = new CopyRequest {track_callback_arg(callback), VarRef {destination}, bytes};
+      os::read_file_stream<CopyCallback>(stream->handle, request);
     }
   };
 
-  struct CloseDirectoryFunc : public NativeFunc {
-    inline static std::string name = "closeDirectory";
+  struct CloseFileStreamFunc : public TypedNativeFunc<CloseFileStreamFunc> {
+    inline static std::string name = "closeFileStream";
 
-    static Var call(RealmAPI& api, CallArgs& args) {
-      auto* dir = api.get_host_object_data<DirectoryObjectInfo>(args[1]);
-      if (!dir) {
-        enqueue_type_error(api, args[2], "Not a valid directory object");
-        return nullptr;
+    static void invoke(RealmAPI& api, FileStreamObjectInfo* stream, js::Callback callback) {
+      // The handle is cleared once the stream has started closing, so that
+      // the destructor does not close it again
+      if (os::close_file_stream<OsCallback>(stream->handle, track_callback_arg(callback))) {
+        stream->handle = 0;
       }
-      auto callback = track_callback_arg(args[2]);
-      os::close_directory<OsCallback>(dir->handle, callback);
-      return nullptr;
     }
   };
 
-  struct StartProcessFunc : public NativeFunc {
+  struct StartProcessFunc : public TypedNativeFunc<StartProcessFunc> {
     inline static std::string name = "startProcess";
 
     struct Callback {
@@ -276,11 +628,15 @@ namespace {
       }
     };
 
-    static Var call(RealmAPI& api, CallArgs& args) {
+    static Var invoke(
+      RealmAPI& api,
+      js::Object args_array,
+      Var process_options,
+      js::Callback callback)
+    {
       os::ProcessOptions options;
 
-      auto args_array = api.to_object(args[1]);
-      auto length_var = api.get_property(args_array, "length");
+      auto length_var = api.get_property<js::names::length>(args_array);
       auto length = api.to_integer(length_var);
 
       for (int i = 0; i < length; ++i) {
@@ -288,12 +644,10 @@ namespace {
         options.args.push_back(api.utf8_string(arg));
       }
 
-      // TODO: handle a options option in position 2
-
-      auto callback = track_callback_arg(args[3]);
+      // TODO: handle process_options
 
       try {
-        int id = os::start_process<Callback>(options, callback);
+        int id = os::start_process<Callback>(options, track_callback_arg(callback));
         return api.create_number(id);
       } catch (const os::Error& error) {
         throw_os_error(api, error);
@@ -302,36 +656,117 @@ namespace {
     }
   };
 
-  struct ObjectBuilder {
-    RealmAPI& _api;
-    Var _object;
+  struct StatsFunc : public TypedNativeFunc<StatsFunc> {
+    inline static std::string name = "stats";
 
-    ObjectBuilder(RealmAPI& api) : _api {api} {
-      _object = _api.create_object();
+    static Var to_ms(RealmAPI& api, uint64_t ns) {
+      return api.create_number(static_cast<double>(ns) / 1e6);
     }
 
-    Var object() { return _object; }
+    static Var count(RealmAPI& api, uint64_t value) {
+      return api.create_number(static_cast<double>(value));
+    }
 
-    template<typename T>
-    void add_method() {
-      auto fn = _api.create_function<T>();
-      _api.set_property(_object, T::name, fn);
+    static Var create_job_stats(RealmAPI& api, const js::JobQueueStats& stats) {
+      using js::JobKind;
+      ObjectBuilder jobs {api};
+      jobs.add_property("call", count(api, stats.job_count(JobKind::call)));
+      jobs.add_property("parseModule", count(api, stats.job_count(JobKind::parse_module)));
+      jobs.add_property("evaluateModule", count(api, stats.job_count(JobKind::evaluate_module)));
+      return jobs.object();
     }
 
-    void add_property(const std::string& name, Var value) {
-      _api.set_property(_object, name, value);
+    static Var create_rejection_stats(RealmAPI& api, const js::RejectionTracker& tracker) {
+      ObjectBuilder rejections {api};
+      rejections.add_property("added", count(api, tracker.added()));
+      rejections.add_property("removed", count(api, tracker.removed()));
+      rejections.add_property("reported", count(api, tracker.reported()));
+      rejections.add_property("pending", count(api, tracker.size()));
+      return rejections.object();
+    }
+
+    static Var create_queue_stats(RealmAPI& api, const js::JobQueueStats& stats) {
+      ObjectBuilder queue {api};
+      queue.add_property("highWaterMark", count(api, stats.high_water_mark));
+      queue.add_property("flushCount", count(api, stats.flush_count));
+      queue.add_property("flushTime", to_ms(api, stats.flush_time_ns));
+      queue.add_property("maxFlushTime", to_ms(api, stats.max_flush_time_ns));
+      queue.add_property("yieldCount", count(api, stats.yield_count));
+      return queue.object();
+    }
+
+    static Var create_loop_stats(RealmAPI& api, const event_loop::LoopStats& stats) {
+      ObjectBuilder handles {api};
+      for (auto& pair : stats.active_handles) {
+        handles.add_property(pair.first, count(api, pair.second));
+      }
+      ObjectBuilder loop {api};
+      loop.add_property("idleTime", to_ms(api, stats.idle_time_ns));
+      loop.add_property("dispatchCount", count(api, stats.dispatch_count));
+      loop.add_property("activeHandles", handles.object());
+      return loop.object();
+    }
+
+    static Var invoke(RealmAPI& api) {
+      // Statistics are only gathered into JS objects when requested
+      auto& job_stats = api.job_queue_stats();
+      ObjectBuilder builder {api};
+      builder.add_property("jobs", create_job_stats(api, job_stats));
+      builder.add_property("queue", create_queue_stats(api, job_stats));
+      builder.add_property("rejections", create_rejection_stats(api, api.rejection_tracker()));
+      builder.add_property("loop", create_loop_stats(api, event_loop::stats()));
+      return builder.object();
     }
   };
 
   Var create_args(RealmAPI& api, int arg_count, char** args) {
-    auto args_array = api.create_array(arg_count);
+    js::ArrayBuilder builder {api};
     for (int i = 0; i < arg_count; ++i) {
-      auto str = api.create_string(args[i]);
-      api.set_indexed_property(args_array, i, str);
+      builder.push(api.create_string(args[i]));
     }
-    return args_array;
+    return builder.finish();
+  }
+
+  // Functions that the bootstrap script does not use. They are installed
+  // only when the sys object is handed to user code.
+  void add_extended_methods(ObjectBuilder& builder) {
+    builder.add_method<ResolveURLFunc>();
+    builder.add_method<TempDirectoryFunc>();
+    builder.add_method<ReadTextFileSyncFunc>();
+    builder.add_method<ReadFileFunc>();
+    builder.add_method<WriteFileFunc>();
+    builder.add_method<StatFileFunc>();
+    builder.add_method<RemoveFileFunc>();
+    builder.add_method<MapFileFunc>();
+
+    builder.add_method<OpenDirectoryFunc>();
+    builder.add_method<ReadDirectoryFunc>();
+    builder.add_method<CloseDirectoryFunc>();
+
+    builder.add_method<OpenFileStreamFunc>();
+    builder.add_method<ReadFileStreamFunc>();
+    builder.add_method<CloseFileStreamFunc>();
+
+    builder.add_method<StartTimerFunc>();
+    builder.add_method<StopTimerFunc>();
+
+    builder.add_method<StartProcessFunc>();
+
+    builder.add_method<StatsFunc>();
   }
 
+  struct InstallAllFunc : public NativeFunc {
+    inline static std::string name = "installAll";
+
+    static Var call(RealmAPI& api, CallArgs& args) {
+      // Installs the remaining functions on the receiver and returns it
+      Var sys = args[0];
+      ObjectBuilder builder {api, sys};
+      add_extended_methods(builder);
+      return sys;
+    }
+  };
+
 }
 
 Var sys_object::create(RealmAPI& api, int arg_count, char** args) {
@@ -343,18 +778,10 @@ Var sys_object::create(RealmAPI& api, int arg_count, char** args) {
   builder.add_method<StdOutFunc>();
   builder.add_method<CwdFunc>();
 
-  builder.add_method<ResolveURLFunc>();
   builder.add_method<ResolveFilePathFunc>();
-  builder.add_method<ReadTextFileSyncFunc>();
-
-  builder.add_method<OpenDirectoryFunc>();
-  builder.add_method<ReadDirectoryFunc>();
-  builder.add_method<CloseDirectoryFunc>();
-
-  builder.add_method<StartTimerFunc>();
-  builder.add_method<StopTimerFunc>();
+  builder.add_method<ReadTextFileFunc>();
 
-  builder.add_method<StartProcessFunc>();
+  builder.add_method<InstallAllFunc>();
 
   return builder.object();
 }
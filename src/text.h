@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ZOE_TEXT_SSE2 1
+#elif (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+// vmaxvq_u8 is AArch64 only; 32-bit ARM uses the word-at-a-time loop
+#include <arm_neon.h>
+#define ZOE_TEXT_NEON 1
+#endif
+
+namespace text {
+
+  // Returns true if every byte in the buffer is a 7-bit ASCII character
+  inline bool is_ascii(const char* data, size_t length) {
+    size_t i = 0;
+
+#if defined(ZOE_TEXT_SSE2)
+    for (; i + 32 <= length; i += 32) {
+      auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+      auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16));
+      if (_mm_movemask_epi8(_mm_or_si128(a, b)) != 0) {
+        return false;
+      }
+    }
+#elif defined(ZOE_TEXT_NEON)
+    for (; i + 32 <= length; i += 32) {
+      auto a = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+      auto b = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i + 16));
+      if (vmaxvq_u8(vorrq_u8(a, b)) >= 0x80) {
+        return false;
+      }
+    }
+#endif
+
+    for (; i + 8 <= length; i += 8) {
+      uint64_t word;
+      std::memcpy(&word, data + i, sizeof(word));
+      if ((word & 0x8080808080808080ull) != 0) {
+        return false;
+      }
+    }
+
+    for (; i < length; ++i) {
+      if (static_cast<unsigned char>(data[i]) >= 0x80) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+}
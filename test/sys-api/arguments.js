@@ -0,0 +1,23 @@
+import { assert } from 'util.js';
+
+function throwsTypeError(fn) {
+  try {
+    fn();
+  } catch (err) {
+    return err instanceof TypeError;
+  }
+  return false;
+}
+
+export async function test(sys) {
+  assert(throwsTypeError(() => sys.startTimer('1', 0, () => {})), 'rejects non-number arguments');
+  assert(throwsTypeError(() => sys.startTimer(-1, 0, () => {})), 'rejects out of range arguments');
+  assert(throwsTypeError(() => sys.startTimer(2 ** 64, 0, () => {})), 'rejects values above the integer range');
+  assert(throwsTypeError(() => sys.startTimer(NaN, 0, () => {})), 'rejects NaN');
+  sys.stopTimer(sys.startTimer(1.5, 0, () => {}));
+  assert(throwsTypeError(() => sys.startTimer(1, 0, null)), 'rejects non-function callbacks');
+  assert(throwsTypeError(() => sys.resolveURL(1, 'file:///')), 'rejects non-string arguments');
+  assert(throwsTypeError(() => sys.stopTimer({})), 'rejects invalid host objects');
+  assert(throwsTypeError(() => sys.closeDirectory(null, () => {})), 'rejects missing host objects');
+  assert(throwsTypeError(() => sys.startProcess('zoe', {}, () => {})), 'rejects non-object arguments');
+}
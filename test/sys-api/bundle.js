@@ -0,0 +1,40 @@
+import { asyncify, assert, runZoe, filePath, mainSource } from 'util.js';
+
+const depSource = `
+export const message = 'bundled';
+`;
+
+const missingSource = `
+import { message } from './missing.js';
+export function main(zoe) {}
+`;
+
+export async function test(sys) {
+  let tempDirectory = sys.tempDirectory();
+  let prefix = `zoe-bundle-test-${ Date.now() }`;
+  let mainURL = sys.resolveURL(`${ prefix }-main.js`, tempDirectory);
+  let depURL = sys.resolveURL(`${ prefix }-dep.js`, tempDirectory);
+  let missingURL = sys.resolveURL(`${ prefix }-missing.js`, tempDirectory);
+  let bundleURL = sys.resolveURL(`${ prefix }.zbundle`, tempDirectory);
+  let markerURL = sys.resolveURL(`${ prefix }.txt`, tempDirectory);
+
+  // A bundle is not written when a module fails to load
+  await asyncify(sys.writeFile)(missingURL, missingSource, false);
+  await runZoe(sys, ['bundle', filePath(missingURL), filePath(bundleURL)]);
+  await asyncify(sys.removeFile)(missingURL);
+  assert(!await asyncify(sys.statFile)(bundleURL), 'bundle is not written for missing modules');
+
+  await asyncify(sys.writeFile)(mainURL, mainSource(`${ prefix }-dep.js`), false);
+  await asyncify(sys.writeFile)(depURL, depSource, false);
+  await runZoe(sys, ['bundle', filePath(mainURL), filePath(bundleURL)]);
+  assert(await asyncify(sys.statFile)(bundleURL), 'bundle is written');
+
+  // The bundle runs without the module sources
+  await asyncify(sys.removeFile)(mainURL);
+  await asyncify(sys.removeFile)(depURL);
+  await runZoe(sys, [filePath(bundleURL), '--zoe-test-sys-api', filePath(markerURL)]);
+  assert(sys.readTextFileSync(markerURL) === 'bundled', 'bundle runs the main module');
+
+  await asyncify(sys.removeFile)(bundleURL);
+  await asyncify(sys.removeFile)(markerURL);
+}
@@ -0,0 +1,137 @@
+import { asyncify, assert, filePath } from 'util.js';
+
+function runShell(sys, command) {
+  return new Promise((resolve, reject) => {
+    sys.startProcess(['/bin/sh', '-c', command], {}, err => {
+      if (err) reject(err);
+      else resolve();
+    });
+  });
+}
+
+// Files of unknown size, such as pipes, are read until end of file
+async function testPipe(sys) {
+  let pipeURL = sys.resolveURL(`zoe-pipe-test-${ Date.now() }`, sys.tempDirectory());
+  let pipePath = filePath(pipeURL);
+  try {
+    await runShell(sys, `mkfifo '${ pipePath }'`);
+  } catch (err) {
+    // Skipped on platforms without a POSIX shell
+    return;
+  }
+  if (!await asyncify(sys.statFile)(pipeURL)) {
+    return;
+  }
+  let writer = runShell(sys, `printf hello > '${ pipePath }'`);
+  let content = await asyncify(sys.readTextFile)(pipeURL);
+  await writer;
+  await asyncify(sys.removeFile)(pipeURL);
+  assert(content === 'hello', 'readTextFile reads pipes');
+}
+
+export async function test(sys) {
+  let url = sys.resolveURL('util.js', import.meta.url);
+  let content = await asyncify(sys.readTextFile)(url);
+  assert(content === sys.readTextFileSync(url), 'readTextFile reads file contents');
+
+  let error = null;
+  try {
+    await asyncify(sys.readTextFile)(sys.resolveURL('missing.js', import.meta.url));
+  } catch (err) {
+    error = err;
+  }
+  assert(error && error.code === 'ENOENT', 'readTextFile reports errors');
+
+  let buffer = await asyncify(sys.readFile)(url);
+  assert(buffer instanceof ArrayBuffer, 'readFile returns an ArrayBuffer');
+  assert(buffer.byteLength === content.length, 'readFile reads file contents');
+
+  let outURL = sys.resolveURL(`zoe-file-test-${ Date.now() }.txt`, sys.tempDirectory());
+  await asyncify(sys.writeFile)(outURL, 'abc', false);
+  assert(sys.readTextFileSync(outURL) === 'abc', 'writeFile writes strings');
+
+  await asyncify(sys.writeFile)(outURL, new Uint8Array([100, 101]), true);
+  assert(sys.readTextFileSync(outURL) === 'de', 'writeFile writes buffers');
+
+  let bytes = new Uint8Array(await asyncify(sys.readFile)(outURL));
+  assert(bytes.length === 2 && bytes[0] === 100 && bytes[1] === 101, 'readFile reads bytes');
+
+  let stat = await asyncify(sys.statFile)(outURL);
+  assert(stat && stat.size === 2, 'statFile reads file size');
+  assert(typeof stat.modifiedTime === 'number', 'statFile reads modification time');
+
+  stat = await asyncify(sys.statFile)(sys.resolveURL('missing.js', import.meta.url));
+  assert(stat === null, 'statFile returns null for missing files');
+
+  error = null;
+  try {
+    await asyncify(sys.readFile)(sys.resolveURL('missing.js', import.meta.url));
+  } catch (err) {
+    error = err;
+  }
+  assert(error && error.code === 'ENOENT', 'readFile reports errors');
+
+  let stream = await asyncify(sys.openFileStream)(url, { chunkSize: 16 });
+  let chunks = [];
+  let chunk;
+  while ((chunk = await asyncify(sys.readFileStream)(stream, null))) {
+    assert(chunk instanceof ArrayBuffer && chunk.byteLength <= 16, 'readFileStream returns chunks');
+    chunks.push(...new Uint8Array(chunk));
+  }
+  assert(chunks.length === buffer.byteLength, 'readFileStream reads file contents');
+  await asyncify(sys.closeFileStream)(stream);
+
+  error = null;
+  try {
+    await asyncify(sys.readFileStream)(stream, null);
+  } catch (err) {
+    error = err;
+  }
+  assert(error, 'readFileStream reports errors for closed streams');
+
+  // Reading into a caller's buffer returns each chunk's memory to the pool
+  // as soon as it is copied, so many more chunks than the pool holds can
+  // be read
+  stream = await asyncify(sys.openFileStream)(url, { chunkSize: 4 });
+  let destination = new Uint8Array(4);
+  let copied = [];
+  let count;
+  while ((count = await asyncify(sys.readFileStream)(stream, destination))) {
+    copied.push(...destination.subarray(0, count));
+  }
+  await asyncify(sys.closeFileStream)(stream);
+  assert(copied.length > 16, 'readFileStream reads more chunks than the pool holds');
+  assert(copied.every((byte, i) => byte === chunks[i]), 'readFileStream copies chunks into buffers');
+
+  // A stream that is closed while a read is pending closes after the read
+  stream = await asyncify(sys.openFileStream)(url, { chunkSize: 16 });
+  let pendingRead = asyncify(sys.readFileStream)(stream, null);
+  await asyncify(sys.closeFileStream)(stream);
+  assert((await pendingRead).byteLength === 16, 'closeFileStream completes pending reads');
+
+  let mapped = sys.mapFile(url);
+  assert(mapped instanceof ArrayBuffer, 'mapFile returns an ArrayBuffer');
+  assert(mapped.byteLength === buffer.byteLength, 'mapFile maps file contents');
+
+  new Uint8Array(sys.mapFile(outURL))[0] = 120;
+  assert(sys.readTextFileSync(outURL) === 'de', 'mapFile does not write to read-only mappings');
+
+  new Uint8Array(sys.mapFile(outURL, { writable: true }))[0] = 120;
+  assert(sys.readTextFileSync(outURL) === 'xe', 'mapFile writes to writable mappings');
+
+  let window = new Uint8Array(sys.mapFile(url, { offset: 5, length: 3 }));
+  assert(window.length === 3 && window.every((byte, i) => byte === chunks[i + 5]), 'mapFile maps ranges');
+
+  error = null;
+  try {
+    sys.mapFile(url, { offset: buffer.byteLength + 1 });
+  } catch (err) {
+    error = err;
+  }
+  assert(error && error.code === 'EINVAL', 'mapFile rejects ranges outside of the file');
+
+  await asyncify(sys.removeFile)(outURL);
+  assert(await asyncify(sys.statFile)(outURL) === null, 'removeFile removes files');
+
+  await testPipe(sys);
+}
@@ -0,0 +1,56 @@
+import { asyncify, assert, runZoe, filePath, mainSource } from 'util.js';
+
+export async function test(sys) {
+  let tempDirectory = sys.tempDirectory();
+  let prefix = `zoe-manifest-test-${ Date.now() }`;
+  let url = name => sys.resolveURL(`${ prefix }-${ name }`, tempDirectory);
+  let mainURL = url('main.js');
+  let manifestURL = url('main.js.zoe-manifest');
+  let markerURL = url('marker.txt');
+  let write = (fileURL, content) => asyncify(sys.writeFile)(fileURL, content, false);
+
+  let run = async (...flags) => {
+    await runZoe(sys, [...flags, filePath(mainURL), '--zoe-test-sys-api', filePath(markerURL)]);
+    let stat = await asyncify(sys.statFile)(markerURL);
+    let content = stat ? sys.readTextFileSync(markerURL) : null;
+    if (stat) {
+      await asyncify(sys.removeFile)(markerURL);
+    }
+    return content;
+  };
+
+  await write(url('a.js'), `export const message = 'a';`);
+  await write(url('b.js'), `export { message } from './${ prefix }-c.js';`);
+  await write(url('c.js'), `export const message = 'c';`);
+  await write(mainURL, mainSource(`${ prefix }-a.js`));
+
+  assert(await run() === 'a', 'program runs without a manifest');
+  assert(!await asyncify(sys.statFile)(manifestURL), 'manifest is not written by default');
+
+  assert(await run('--zoe-module-manifest') === 'a', 'program runs when recording a manifest');
+  assert(sys.readTextFileSync(manifestURL).includes(`${ prefix }-a.js`), 'manifest lists loaded modules');
+
+  // A manifest recorded for a different version of the entry point is
+  // ignored and rewritten
+  await write(mainURL, mainSource(`${ prefix }-b.js`));
+  assert(await run('--zoe-module-manifest') === 'c', 'stale manifest is ignored');
+  let manifest = sys.readTextFileSync(manifestURL);
+  assert(
+    manifest.includes(`${ prefix }-c.js`) && !manifest.includes(`${ prefix }-a.js`),
+    'stale manifest is rewritten');
+
+  // A module listed in the manifest that no longer exists does not
+  // affect a program that no longer imports it
+  await write(url('b.js'), `export const message = 'b';`);
+  await asyncify(sys.removeFile)(url('c.js'));
+  assert(await run('--zoe-module-manifest') === 'b', 'missing manifest modules are ignored');
+  assert(!sys.readTextFileSync(manifestURL).includes(`${ prefix }-c.js`), 'missing modules are removed from the manifest');
+
+  // A missing module that is still imported fails to load
+  await asyncify(sys.removeFile)(url('b.js'));
+  assert(await run('--zoe-module-manifest') === null, 'missing imported modules fail to load');
+
+  for (let name of ['a.js', 'main.js', 'main.js.zoe-manifest']) {
+    await asyncify(sys.removeFile)(url(name));
+  }
+}
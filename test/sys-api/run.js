@@ -1,12 +1,22 @@
+import * as args from 'arguments.js';
+import * as bundle from 'bundle.js';
 import * as directory from 'directory.js';
+import * as file from 'file.js';
+import * as manifest from 'manifest.js';
 import * as timer from 'timer.js';
 import * as process from 'process.js';
+import * as stats from 'stats.js';
 
 export async function main(zoe) {
   if (!zoe.sys) {
     throw new Error('zoe.sys is not defined (use --zoe-test-sys-api flag to enable)');
   }
+  await args.test(zoe.sys);
   await directory.test(zoe.sys);
+  await file.test(zoe.sys);
   await timer.test(zoe.sys);
   await process.test(zoe.sys);
+  await stats.test(zoe.sys);
+  await bundle.test(zoe.sys);
+  await manifest.test(zoe.sys);
 }
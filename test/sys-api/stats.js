@@ -0,0 +1,26 @@
+import { assert } from 'util.js';
+
+export async function test(sys) {
+  await Promise.resolve();
+  let stats = sys.stats();
+  assert(stats.jobs.call > 0, 'counts call jobs');
+  assert(stats.jobs.parseModule > 0, 'counts parse jobs');
+  assert(stats.queue.highWaterMark > 0, 'tracks queue high-water mark');
+  assert(stats.queue.flushCount > 0, 'counts flushes');
+  assert(typeof stats.queue.flushTime === 'number', 'reports flush time');
+  assert(stats.queue.yieldCount === 0, 'does not yield without a budget');
+  assert(typeof stats.loop.idleTime === 'number', 'reports loop idle time');
+
+  // A handler attached by a later job in the same turn is not reported
+  let rejected = Promise.reject(new Error('late handler'));
+  await null;
+  rejected.catch(() => {});
+  stats = sys.stats();
+  assert(stats.rejections.added > 0, 'tracks unhandled rejections');
+  assert(stats.rejections.removed > 0, 'untracks late-handled rejections');
+
+  let timer = sys.startTimer(1000, 0, () => {});
+  stats = sys.stats();
+  sys.stopTimer(timer);
+  assert(stats.loop.activeHandles.timer > 0, 'counts active handles by type');
+}
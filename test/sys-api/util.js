@@ -23,3 +23,30 @@ export function assert(x, message) {
     throw new AssertionError(message, Boolean(x), true);
   }
 }
+
+// Runs zoe in a child process with the given arguments
+export function runZoe(sys, args) {
+  return new Promise((resolve, reject) => {
+    sys.startProcess([sys.args[0], ...args], {}, err => {
+      if (err) reject(err);
+      else resolve();
+    });
+  });
+}
+
+// Returns the file system path for a file URL
+export function filePath(url) {
+  return decodeURIComponent(url.slice('file://'.length));
+}
+
+// Returns the source of a main module that imports `message` from
+// `depName` and writes it to the file named by its first argument
+export function mainSource(depName) {
+  return `
+import { message } from './${ depName }';
+export function main(zoe) {
+  let url = zoe.sys.resolveFilePath(zoe.args()[2], zoe.sys.cwd());
+  zoe.sys.writeFile(url, message, false, () => {});
+}
+`;
+}